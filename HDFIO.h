@@ -11,9 +11,10 @@
 #include <cassert>
 
 // we use H5_HAVE_PARALLEL defined in hdf5.h to signal whether we have MPI support or not
+// (with serial HDF5 in an MPI code, i.e., mpi.h included before this header, the communicators are ignored)
 #ifdef H5_HAVE_PARALLEL
 #include <mpi.h>
-#else
+#elif !defined(MPI_VERSION)
 #ifndef MPI_Comm
 #define MPI_Comm int
 #endif
@@ -38,6 +39,30 @@ namespace NameSpaceHDFIO {
     template<> inline void FLASHPropAssign<int>    (int    val, int    * data) { *data = val; }; // simply assign
     template<> inline void FLASHPropAssign<double> (double val, double * data) { *data = val; }; // simply assign
     template<> inline void FLASHPropAssign<bool>   (bool   val, bool   * data) { *data = val; }; // simply assign
+    // file access tuning for large parallel writes (see HDFIO::setIOOptions); 0 (false) keeps the HDF5 / MPI-IO default
+    struct IOOptions {
+        hsize_t alignment; // align file objects to multiples of this many bytes (e.g., the file system stripe size)
+        hsize_t alignment_threshold; // only align objects of at least this many bytes (0: all objects)
+        size_t metadata_cache_size; // initial (and minimum) size of the metadata cache in bytes
+        bool collective_metadata; // collective metadata reads and writes (parallel HDF5 >= 1.10)
+        int cb_nodes; // MPI-IO hint 'cb_nodes': number of collective-buffering aggregators
+        long cb_buffer_size; // MPI-IO hint 'cb_buffer_size': collective-buffering buffer size in bytes
+        int striping_factor; // MPI-IO hint 'striping_factor': number of stripes (OSTs) of newly created files
+        long striping_unit; // MPI-IO hint 'striping_unit': stripe size in bytes of newly created files
+        IOOptions() : alignment(0), alignment_threshold(0), metadata_cache_size(0), collective_metadata(false),
+                      cb_nodes(0), cb_buffer_size(0), striping_factor(0), striping_unit(0) {};
+    };
+    // source of a virtual dataset (see HDFIO::create_virtual_dataset): dataset Datasetname in file Filename
+    // (relative to the directory of the virtual dataset's file) is mapped to the hyperslab Offset, Count
+    struct VirtualSource {
+        std::string Filename, Datasetname;
+        std::vector<hsize_t> Offset, Count;
+    };
+    // open dataset with its file dataspace and transfer property list (see HDFIO::setHandleCache)
+    struct DatasetHandle {
+        hid_t dataset, dataspace, xfer_plist;
+        bool collective; // whether xfer_plist is set up for collective MPI-IO
+    };
 }
 
 /**
@@ -61,6 +86,9 @@ class HDFIO
     hsize_t HDFSize, HDFDims[4]; // HDF5 stuff; can maximally handle 4D datasets (but who would ever want more?)
     herr_t  HDF5_status, HDF5_error; // HDF5 stuff
     int Verbose; // verbose level for printing to stdout
+    NameSpaceHDFIO::IOOptions IOOpts; // file access tuning (alignment, metadata cache, MPI-IO hints)
+    bool CacheHandles; // keep datasets open between calls (see setHandleCache)
+    std::map<std::string, NameSpaceHDFIO::DatasetHandle> Handles; // cached dataset handles (by dataset name)
 
     /// Constructors
     public: HDFIO(void)
@@ -113,6 +141,7 @@ class HDFIO
         HDFSize = 0; // HDF5 buffer size 0
         HDF5_status = 0; // HDF5 status 0
         HDF5_error = -1; // HDF5 error -1
+        CacheHandles = false; // open and close datasets in every call
         for (unsigned int i = 0; i < 4; i++) HDFDims[i] = 0; // set Dimensions to (0,0,0,0)
         if (Filename != "") this->open(Filename, read_write_char, comm); // open file if provided in constructor
     };
@@ -141,14 +170,7 @@ class HDFIO
     {
         this->Filename = Filename;
 
-        hid_t plist_id = H5P_DEFAULT;
-#ifdef H5_HAVE_PARALLEL
-        if (comm != MPI_COMM_NULL) {
-            plist_id = H5Pcreate(H5P_FILE_ACCESS);
-            H5Pset_fapl_mpio(plist_id, comm, MPI_INFO_NULL);
-            assert( HDF5_status != HDF5_error );
-        }
-#endif
+        hid_t plist_id = this->create_fapl(comm); // file access property list
         switch (read_write_char)
         {
             case 'r':
@@ -173,9 +195,89 @@ class HDFIO
                 break;
             }
         }
+        if (plist_id != H5P_DEFAULT) H5Pclose(plist_id);
+    };
+
+    /**
+     * set file access tuning options for subsequent open/create calls, e.g., for many MPI ranks writing to a
+     * parallel file system: alignment of datasets to the stripe size, metadata cache size, collective metadata
+     * operations, and the MPI-IO hints for collective buffering and striping (see NameSpaceHDFIO::IOOptions)
+     * @param Options options (members that are 0 keep the HDF5 / MPI-IO default)
+     */
+    public: void setIOOptions(const NameSpaceHDFIO::IOOptions Options)
+    {
+        IOOpts = Options;
+    };
+
+    /**
+     * get file access tuning options
+     * @return options
+     */
+    public: NameSpaceHDFIO::IOOptions getIOOptions(void) const
+    {
+        return IOOpts;
+    };
+
+    /**
+     * create the file access property list for open/create with the IOOptions
+     * @param comm: MPI communicator for parallel file I/O
+     * @return property list (H5P_DEFAULT in serial mode without options; else to be closed by the caller)
+     */
+    private: hid_t create_fapl(MPI_Comm comm)
+    {
+        bool tuned = (IOOpts.alignment > 0) || (IOOpts.metadata_cache_size > 0);
+        if ((comm == MPI_COMM_NULL) && !tuned) return H5P_DEFAULT;
+        hid_t plist_id = H5Pcreate(H5P_FILE_ACCESS);
+        assert( plist_id != HDF5_error );
 #ifdef H5_HAVE_PARALLEL
-        if (comm != MPI_COMM_NULL) H5Pclose(plist_id);
+        if (comm != MPI_COMM_NULL) {
+            // MPI-IO hints (only those that are set)
+            MPI_Info info = MPI_INFO_NULL;
+            std::map<std::string, long> hints;
+            if (IOOpts.cb_nodes > 0) hints["cb_nodes"] = IOOpts.cb_nodes;
+            if (IOOpts.cb_buffer_size > 0) hints["cb_buffer_size"] = IOOpts.cb_buffer_size;
+            if (IOOpts.striping_factor > 0) hints["striping_factor"] = IOOpts.striping_factor;
+            if (IOOpts.striping_unit > 0) hints["striping_unit"] = IOOpts.striping_unit;
+            if (hints.size() > 0) {
+                MPI_Info_create(&info);
+                for (std::map<std::string, long>::iterator it = hints.begin(); it != hints.end(); it++) {
+                    MPI_Info_set(info, it->first.c_str(), std::to_string(it->second).c_str());
+                    if (Verbose > 1) std::cout<<FuncSig(__func__)<<"MPI-IO hint "<<it->first<<" = "<<it->second<<std::endl;
+                }
+            }
+            HDF5_status = H5Pset_fapl_mpio(plist_id, comm, info); // HDF5 keeps its own copy of info
+            assert( HDF5_status != HDF5_error );
+            if (info != MPI_INFO_NULL) MPI_Info_free(&info);
+#if H5_VERSION_GE(1,10,0)
+            if (IOOpts.collective_metadata) {
+                HDF5_status = H5Pset_all_coll_metadata_ops(plist_id, true);
+                assert( HDF5_status != HDF5_error );
+                HDF5_status = H5Pset_coll_metadata_write(plist_id, true);
+                assert( HDF5_status != HDF5_error );
+            }
+#else
+            if (IOOpts.collective_metadata && (Verbose > 0))
+                std::cout<<FuncSig(__func__)<<"WARNING: collective metadata operations require HDF5 >= 1.10; ignored."<<std::endl;
+#endif
+        }
 #endif
+        if (IOOpts.alignment > 0) {
+            HDF5_status = H5Pset_alignment(plist_id, std::max<hsize_t>(1, IOOpts.alignment_threshold), IOOpts.alignment);
+            assert( HDF5_status != HDF5_error );
+        }
+        if (IOOpts.metadata_cache_size > 0) {
+            H5AC_cache_config_t mdc_config;
+            mdc_config.version = H5AC__CURR_CACHE_CONFIG_VERSION;
+            HDF5_status = H5Pget_mdc_config(plist_id, &mdc_config);
+            assert( HDF5_status != HDF5_error );
+            mdc_config.set_initial_size = true;
+            mdc_config.initial_size = IOOpts.metadata_cache_size;
+            mdc_config.min_size = IOOpts.metadata_cache_size;
+            mdc_config.max_size = std::max(mdc_config.max_size, IOOpts.metadata_cache_size);
+            HDF5_status = H5Pset_mdc_config(plist_id, &mdc_config);
+            assert( HDF5_status != HDF5_error );
+        }
+        return plist_id;
     };
 
     /**
@@ -183,11 +285,109 @@ class HDFIO
      */
     public: void close(void)
     {
+        // close cached dataset handles
+        this->close_handles();
         // close HDF5 file
         HDF5_status = H5Fclose(File_id);
         assert( HDF5_status != HDF5_error );
     };
 
+    /**
+     * switch the dataset handle cache on or off; with the cache, read, read_slab, overwrite_slab and overwrite keep
+     * each dataset open (with its file dataspace and transfer property list) until close(), instead of opening and
+     * closing it in every call (e.g., for streaming a dataset in many slabs)
+     * @param cache true: cache dataset handles; false: close cached handles and open datasets in every call
+     */
+    public: void setHandleCache(const bool cache)
+    {
+        CacheHandles = cache;
+        if (!CacheHandles) this->close_handles();
+    };
+
+    /**
+     * open dataset (or get it from the handle cache) and update Rank, HDFDims and HDFSize
+     * @param Datasetname datasetname
+     * @param comm: MPI communicator for parallel file I/O (collective transfer property list)
+     * @return dataset handle (to be released with close_dataset)
+     */
+    private: NameSpaceHDFIO::DatasetHandle open_dataset(const std::string Datasetname, MPI_Comm comm)
+    {
+        NameSpaceHDFIO::DatasetHandle handle;
+        std::map<std::string, NameSpaceHDFIO::DatasetHandle>::iterator it = Handles.find(Datasetname);
+        if (it != Handles.end()) handle = it->second;
+        else {
+            // open dataset
+            handle.dataset = H5Dopen(File_id, Datasetname.c_str(), H5P_DEFAULT);
+            assert( handle.dataset != HDF5_error );
+            // open dataspace (to get dimensions)
+            handle.dataspace = H5Dget_space(handle.dataset);
+            assert( handle.dataspace != HDF5_error );
+            handle.xfer_plist = H5P_DEFAULT;
+            handle.collective = false;
+        }
+#ifdef H5_HAVE_PARALLEL
+        /// (re-)create property list for collective dataset i/o
+        if (handle.collective != (comm != MPI_COMM_NULL)) {
+            if (handle.xfer_plist != H5P_DEFAULT) {
+                HDF5_status = H5Pclose(handle.xfer_plist);
+                assert( HDF5_status != HDF5_error );
+            }
+            handle.xfer_plist = H5P_DEFAULT;
+            handle.collective = (comm != MPI_COMM_NULL);
+            if (handle.collective) {
+                handle.xfer_plist = H5Pcreate(H5P_DATASET_XFER);
+                H5Pset_dxpl_mpio(handle.xfer_plist, H5FD_MPIO_COLLECTIVE);
+            }
+        }
+#endif
+        if (CacheHandles) Handles[Datasetname] = handle;
+        // get dimensional information from dataspace and update HDFSize
+        hsize_t HDFxdims[4], HDFmaxdims[4];
+        Rank = H5Sget_simple_extent_dims(handle.dataspace, HDFxdims, HDFmaxdims);
+        HDFSize = 1;
+        for (int i = 0; i < Rank; i++) {
+            HDFDims[i] = HDFxdims[i];
+            HDFSize *= HDFDims[i];
+        }
+        return handle;
+    };
+
+    /**
+     * release dataset handle from open_dataset (closes it, unless it is cached)
+     * @param handle dataset handle
+     */
+    private: void close_dataset(NameSpaceHDFIO::DatasetHandle & handle)
+    {
+        if (CacheHandles) return;
+        if (handle.xfer_plist != H5P_DEFAULT) {
+            HDF5_status = H5Pclose(handle.xfer_plist);
+            assert( HDF5_status != HDF5_error );
+        }
+        HDF5_status = H5Sclose(handle.dataspace);
+        assert( HDF5_status != HDF5_error );
+        HDF5_status = H5Dclose(handle.dataset);
+        assert( HDF5_status != HDF5_error );
+    };
+
+    /**
+     * close all cached dataset handles (or the one of Datasetname)
+     */
+    private: void close_handles(void)
+    {
+        while (Handles.size() > 0) this->close_handle(Handles.begin()->first);
+    };
+    private: void close_handle(const std::string Datasetname)
+    {
+        std::map<std::string, NameSpaceHDFIO::DatasetHandle>::iterator it = Handles.find(Datasetname);
+        if (it == Handles.end()) return;
+        NameSpaceHDFIO::DatasetHandle handle = it->second;
+        Handles.erase(it);
+        bool cache = CacheHandles;
+        CacheHandles = false; // so that close_dataset closes it
+        this->close_dataset(handle);
+        CacheHandles = cache;
+    };
+
     /**
      * read data from a dataset
      * @param *DataBuffer pointer to double/float/int array to which data is to be written
@@ -208,39 +408,14 @@ class HDFIO
      */
     public: void read(void* const DataBuffer, const std::string Datasetname, const hid_t DataType, MPI_Comm comm)
     {
-        // get dimensional information from dataspace and update HDFSize
-        this->getDims(Datasetname);
-
-        // open dataset
-        Dataset_id = H5Dopen(File_id, Datasetname.c_str(), H5P_DEFAULT);
-        assert( Dataset_id != HDF5_error );
+        // open dataset and dataspace, get dimensional information and update HDFSize
+        NameSpaceHDFIO::DatasetHandle handle = this->open_dataset(Datasetname, comm);
 
-        // open dataspace (to get dimensions)
-        Dataspace_id = H5Dget_space(Dataset_id);
-        assert( Dataspace_id != HDF5_error );
-
-        /// create property list for collective dataset i/o
-        hid_t plist_id = H5P_DEFAULT;
-#ifdef H5_HAVE_PARALLEL
-        if (comm != MPI_COMM_NULL) {
-            plist_id = H5Pcreate(H5P_DATASET_XFER);
-            H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_COLLECTIVE);
-        }
-#endif
         // read buffer /memspaceid //filespaceid
-        HDF5_status = H5Dread(Dataset_id, DataType, H5S_ALL, H5S_ALL, plist_id, DataBuffer);
-        assert( HDF5_status != HDF5_error );
-#ifdef H5_HAVE_PARALLEL
-        if (comm != MPI_COMM_NULL) {
-            HDF5_status = H5Pclose(plist_id);
-            assert( HDF5_status != HDF5_error );
-        }
-#endif
-        HDF5_status = H5Sclose(Dataspace_id);
+        HDF5_status = H5Dread(handle.dataset, DataType, H5S_ALL, H5S_ALL, handle.xfer_plist, DataBuffer);
         assert( HDF5_status != HDF5_error );
 
-        HDF5_status = H5Dclose(Dataset_id);
-        assert( HDF5_status != HDF5_error );
+        this->close_dataset(handle);
     }; // read
 
     /**
@@ -380,19 +555,11 @@ class HDFIO
                             const hsize_t out_rank, const hsize_t out_offset[], const hsize_t out_count[],
                             const hsize_t total_out_count[], MPI_Comm comm)
     {
-        // get dimensional information from dataspace and update HDFSize
-        this->getDims(Datasetname);
-
-        // open dataset
-        Dataset_id = H5Dopen(File_id, Datasetname.c_str(), H5P_DEFAULT);
-        assert( Dataset_id != HDF5_error );
-
-        // open dataspace (to get dimensions)
-        Dataspace_id = H5Dget_space(Dataset_id);
-        assert( Dataspace_id != HDF5_error );
+        // open dataset and dataspace, get dimensional information and update HDFSize
+        NameSpaceHDFIO::DatasetHandle handle = this->open_dataset(Datasetname, comm);
 
         // select hyperslab
-        HDF5_status = H5Sselect_hyperslab(Dataspace_id, H5S_SELECT_SET, offset, NULL, count, NULL);
+        HDF5_status = H5Sselect_hyperslab(handle.dataspace, H5S_SELECT_SET, offset, NULL, count, NULL);
         assert( HDF5_status != HDF5_error );
 
         // create memspace
@@ -400,31 +567,14 @@ class HDFIO
         HDF5_status = H5Sselect_hyperslab(Memspace_id, H5S_SELECT_SET, out_offset, NULL, out_count, NULL);
         assert( HDF5_status != HDF5_error );
 
-        /// create property list for collective dataset i/o
-        hid_t plist_id = H5P_DEFAULT;
-#ifdef H5_HAVE_PARALLEL
-        if (comm != MPI_COMM_NULL) {
-            plist_id = H5Pcreate(H5P_DATASET_XFER);
-            H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_COLLECTIVE);
-        }
-#endif
         // read buffer
-        HDF5_status = H5Dread(Dataset_id, DataType, Memspace_id, Dataspace_id, plist_id, DataBuffer );
-        assert( HDF5_status != HDF5_error );
-#ifdef H5_HAVE_PARALLEL
-        if (comm != MPI_COMM_NULL) {
-            HDF5_status = H5Pclose(plist_id);
-            assert( HDF5_status != HDF5_error );
-        }
-#endif
-        HDF5_status = H5Sclose(Memspace_id);
+        HDF5_status = H5Dread(handle.dataset, DataType, Memspace_id, handle.dataspace, handle.xfer_plist, DataBuffer);
         assert( HDF5_status != HDF5_error );
 
-        HDF5_status = H5Sclose(Dataspace_id);
+        HDF5_status = H5Sclose(Memspace_id);
         assert( HDF5_status != HDF5_error );
 
-        HDF5_status = H5Dclose(Dataset_id);
-        assert( HDF5_status != HDF5_error );
+        this->close_dataset(handle);
 
     }; // read_slab
 
@@ -464,19 +614,11 @@ class HDFIO
                                 const hsize_t out_rank, const hsize_t out_offset[], const hsize_t out_count[],
                                 MPI_Comm comm)
     {
-        // get dimensional information from dataspace and update HDFSize
-        this->getDims(Datasetname);
-
-        // open dataset
-        Dataset_id = H5Dopen(File_id, Datasetname.c_str(), H5P_DEFAULT);
-        assert( Dataset_id != HDF5_error );
-
-        // open dataspace (to get dimensions)
-        Dataspace_id = H5Dget_space(Dataset_id);
-        assert( Dataspace_id != HDF5_error );
+        // open dataset and dataspace, get dimensional information and update HDFSize
+        NameSpaceHDFIO::DatasetHandle handle = this->open_dataset(Datasetname, comm);
 
         // select hyperslab
-        HDF5_status = H5Sselect_hyperslab(Dataspace_id, H5S_SELECT_SET, offset, NULL, count, NULL);
+        HDF5_status = H5Sselect_hyperslab(handle.dataspace, H5S_SELECT_SET, offset, NULL, count, NULL);
         assert( HDF5_status != HDF5_error );
 
         // create memspace
@@ -484,31 +626,14 @@ class HDFIO
         HDF5_status = H5Sselect_hyperslab(Memspace_id, H5S_SELECT_SET, out_offset, NULL, out_count, NULL);
         assert( HDF5_status != HDF5_error );
 
-        /// create property list for collective dataset i/o
-        hid_t plist_id = H5P_DEFAULT;
-#ifdef H5_HAVE_PARALLEL
-        if (comm != MPI_COMM_NULL) {
-            plist_id = H5Pcreate(H5P_DATASET_XFER);
-            H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_COLLECTIVE);
-        }
-#endif
         // overwrite dataset
-        HDF5_status = H5Dwrite(Dataset_id, DataType, Memspace_id, Dataspace_id, plist_id, DataBuffer);
-        assert( HDF5_status != HDF5_error );
-#ifdef H5_HAVE_PARALLEL
-        if (comm != MPI_COMM_NULL) {
-            HDF5_status = H5Pclose(plist_id);
-            assert( HDF5_status != HDF5_error );
-        }
-#endif
-        HDF5_status = H5Sclose(Memspace_id);
+        HDF5_status = H5Dwrite(handle.dataset, DataType, Memspace_id, handle.dataspace, handle.xfer_plist, DataBuffer);
         assert( HDF5_status != HDF5_error );
 
-        HDF5_status = H5Sclose(Dataspace_id);
+        HDF5_status = H5Sclose(Memspace_id);
         assert( HDF5_status != HDF5_error );
 
-        HDF5_status = H5Dclose(Dataset_id);
-        assert( HDF5_status != HDF5_error );
+        this->close_dataset(handle);
 
     }; // overwrite_slab
 
@@ -532,39 +657,14 @@ class HDFIO
      */
     public: void overwrite(const void* const DataBuffer, const std::string Datasetname, const hid_t DataType, MPI_Comm comm)
     {
-        // get dimensional information from dataspace and update HDFSize
-        this->getDims(Datasetname);
+        // open dataset and dataspace, get dimensional information and update HDFSize
+        NameSpaceHDFIO::DatasetHandle handle = this->open_dataset(Datasetname, comm);
 
-        // open dataset
-        Dataset_id = H5Dopen(File_id, Datasetname.c_str(), H5P_DEFAULT);
-        assert( Dataset_id != HDF5_error );
-
-        // open dataspace (to get dimensions)
-        Dataspace_id = H5Dget_space(Dataset_id);
-        assert( Dataspace_id != HDF5_error );
-
-        /// create property list for collective dataset i/o
-        hid_t plist_id = H5P_DEFAULT;
-#ifdef H5_HAVE_PARALLEL
-        if (comm != MPI_COMM_NULL) {
-            plist_id = H5Pcreate(H5P_DATASET_XFER);
-            H5Pset_dxpl_mpio(plist_id, H5FD_MPIO_COLLECTIVE);
-        }
-#endif
         // overwrite dataset
-        HDF5_status = H5Dwrite(Dataset_id, DataType, H5S_ALL, H5S_ALL, plist_id, DataBuffer);
-        assert( HDF5_status != HDF5_error );
-#ifdef H5_HAVE_PARALLEL
-        if (comm != MPI_COMM_NULL) {
-            HDF5_status = H5Pclose(plist_id);
-            assert( HDF5_status != HDF5_error );
-        }
-#endif
-        HDF5_status = H5Sclose(Dataspace_id);
+        HDF5_status = H5Dwrite(handle.dataset, DataType, H5S_ALL, H5S_ALL, handle.xfer_plist, DataBuffer);
         assert( HDF5_status != HDF5_error );
 
-        HDF5_status = H5Dclose(Dataset_id);
-        assert( HDF5_status != HDF5_error );
+        this->close_dataset(handle);
 
     }; // overwrite
 
@@ -586,20 +686,12 @@ class HDFIO
     {
         this->Filename = Filename;
 
-        hid_t plist_id = H5P_DEFAULT;
-#ifdef H5_HAVE_PARALLEL
-        if (comm != MPI_COMM_NULL) {
-            plist_id = H5Pcreate(H5P_FILE_ACCESS);
-            H5Pset_fapl_mpio(plist_id, comm, MPI_INFO_NULL);
-        }
-#endif
+        hid_t plist_id = this->create_fapl(comm); // file access property list
         // create HDF5 file (overwrite)
         File_id = H5Fcreate(Filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, plist_id);
         assert( File_id != HDF5_error );
 
-#ifdef H5_HAVE_PARALLEL
-        if (comm != MPI_COMM_NULL) H5Pclose(plist_id);
-#endif
+        if (plist_id != H5P_DEFAULT) H5Pclose(plist_id);
     };
 
     /**
@@ -625,6 +717,29 @@ class HDFIO
      */
     public: void write( const void* const DataBuffer, const std::string Datasetname,
                         const std::vector<int> Dimensions, const hid_t DataType, MPI_Comm comm)
+    {
+        this->write(DataBuffer, Datasetname, this->toHDFDims(Dimensions), DataType, comm);
+    };
+
+    /**
+     * write HDF5 dataset (serial mode) with 64-bit dimensions (e.g., for datasets with more than 2^31 elements)
+     */
+    public: void write( const void* const DataBuffer, const std::string Datasetname,
+                        const std::vector<hsize_t> Dimensions, const hid_t DataType)
+    {
+        this->write(DataBuffer, Datasetname, Dimensions, DataType, MPI_COMM_NULL);
+    };
+
+    /**
+     * write HDF5 dataset (overloaded) with 64-bit dimensions (e.g., for datasets with more than 2^31 elements)
+     * @param DataBuffer int/float/double array containing the data
+     * @param Datasetname datasetname
+     * @param Dimensions dataset dimensions
+     * @param DataType (i.e. H5T_STD_I32LE)
+     * @param comm: MPI communicator for parallel file I/O
+     */
+    public: void write( const void* const DataBuffer, const std::string Datasetname,
+                        const std::vector<hsize_t> Dimensions, const hid_t DataType, MPI_Comm comm)
     {
         this->setDims(Dimensions); // set dimensions
         this->write(DataBuffer, Datasetname, DataType, comm); // call write
@@ -693,6 +808,40 @@ class HDFIO
      */
     public: void create_dataset(const std::string Datasetname, const std::vector<int> Dimensions,
                                 const hid_t DataType, MPI_Comm comm)
+    {
+        std::vector<hsize_t> ChunkDimensions(0); // contiguous dataset without filters
+        this->create_dataset(Datasetname, this->toHDFDims(Dimensions), DataType, comm, ChunkDimensions, false, 0, -1);
+    };
+
+    /**
+     * create empty HDF5 dataset (overloaded) with chunked layout and compression filters
+     * (see the overload with 64-bit dimensions below)
+     */
+    public: void create_dataset(const std::string Datasetname, const std::vector<int> Dimensions,
+                                const hid_t DataType, MPI_Comm comm, const std::vector<int> ChunkDimensions,
+                                const bool shuffle, const int deflate_level, const int scale_offset)
+    {
+        this->create_dataset(Datasetname, this->toHDFDims(Dimensions), DataType, comm, this->toHDFDims(ChunkDimensions),
+                             shuffle, deflate_level, scale_offset);
+    };
+
+    /**
+     * create empty HDF5 dataset (overloaded) with chunked layout and compression filters, and 64-bit dimensions
+     * @param Datasetname datasetname
+     * @param Dimensions dataset dimensions (e.g., 4096^3 elements)
+     * @param DataType (i.e. H5T_IEEE_F32BE, H5T_STD_I32LE, ...)
+     * @param comm: MPI communicator for parallel file I/O
+     * @param ChunkDimensions chunk dimensions (same rank as Dimensions; empty: contiguous layout, no filters),
+     *        e.g., the extent written by each MPI rank, so that each rank writes whole chunks
+     * @param shuffle byte-shuffle filter (improves the compression of floating-point data)
+     * @param deflate_level gzip compression level (1-9; 0: no deflate)
+     * @param scale_offset scale-offset filter (lossy for floating-point data): number of decimal digits kept
+     *        after the decimal point (< 0: no scale-offset filter)
+     * Filters in parallel (comm != MPI_COMM_NULL) require HDF5 >= 1.10.2 and collective writes (see overwrite_slab).
+     */
+    public: void create_dataset(const std::string Datasetname, const std::vector<hsize_t> Dimensions,
+                                const hid_t DataType, MPI_Comm comm, const std::vector<hsize_t> ChunkDimensions,
+                                const bool shuffle, const int deflate_level, const int scale_offset)
     {
         this->setDims(Dimensions); // set dimensions
 
@@ -700,9 +849,54 @@ class HDFIO
         Dataspace_id = H5Screate_simple(Rank, HDFDims, NULL);
         assert( Dataspace_id != HDF5_error );
 
+        // -------------- dataset creation property list (chunks and filters)
+        hid_t dcpl_id = H5P_DEFAULT;
+        if (ChunkDimensions.size() > 0) {
+            assert( (int)ChunkDimensions.size() == Rank );
+            hsize_t chunk_dims[4];
+            for (int i = 0; i < Rank; i++)
+                chunk_dims[i] = std::max<hsize_t>(1, std::min<hsize_t>(HDFDims[i], ChunkDimensions[i]));
+            dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+            HDF5_status = H5Pset_chunk(dcpl_id, Rank, chunk_dims);
+            assert( HDF5_status != HDF5_error );
+            bool use_filters = true;
+#if defined(H5_HAVE_PARALLEL) && !H5_VERSION_GE(1,10,2)
+            if (comm != MPI_COMM_NULL) {
+                if (Verbose > 0) std::cout<<ClassSignature<<"create_dataset: WARNING: parallel writes with filters require HDF5 >= 1.10.2; "
+                                          <<"writing '"<<Datasetname<<"' uncompressed."<<std::endl;
+                use_filters = false;
+            }
+#endif
+            if (use_filters) {
+                if (scale_offset >= 0) {
+                    H5Z_SO_scale_type_t scale_type = (H5Tget_class(DataType) == H5T_FLOAT) ? H5Z_SO_FLOAT_DSCALE : H5Z_SO_INT;
+                    HDF5_status = H5Pset_scaleoffset(dcpl_id, scale_type, scale_offset);
+                    assert( HDF5_status != HDF5_error );
+                }
+                if (shuffle) {
+                    HDF5_status = H5Pset_shuffle(dcpl_id);
+                    assert( HDF5_status != HDF5_error );
+                }
+                if (deflate_level > 0) {
+                    if (H5Zfilter_avail(H5Z_FILTER_DEFLATE) > 0) {
+                        HDF5_status = H5Pset_deflate(dcpl_id, std::min(deflate_level, 9));
+                        assert( HDF5_status != HDF5_error );
+                    } else if (Verbose > 0) std::cout<<ClassSignature<<"create_dataset: WARNING: deflate filter not available; "
+                                                     <<"writing '"<<Datasetname<<"' without deflate."<<std::endl;
+                }
+            }
+#ifdef H5_HAVE_PARALLEL
+            if ((comm != MPI_COMM_NULL) && (H5Pget_nfilters(dcpl_id) == 0)) { // unfiltered: allocate at creation, skip fill values
+                H5Pset_alloc_time(dcpl_id, H5D_ALLOC_TIME_EARLY);
+                H5Pset_fill_time(dcpl_id, H5D_FILL_TIME_NEVER);
+            }
+#endif
+        }
+
         // -------------- create dataset
-        Dataset_id = H5Dcreate(File_id, Datasetname.c_str(), DataType, Dataspace_id, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+        Dataset_id = H5Dcreate(File_id, Datasetname.c_str(), DataType, Dataspace_id, H5P_DEFAULT, dcpl_id, H5P_DEFAULT);
         assert( Dataset_id != HDF5_error );
+        if (dcpl_id != H5P_DEFAULT) H5Pclose(dcpl_id);
 
         // -------------- close dataset
         HDF5_status = H5Dclose(Dataset_id);
@@ -713,6 +907,57 @@ class HDFIO
         assert( HDF5_status != HDF5_error );
     };
 
+    /**
+     * create an HDF5 virtual dataset (HDF5 >= 1.10), which stitches together datasets in other files,
+     * e.g., the pieces of a field written by each MPI rank into its own file
+     * @param Datasetname datasetname
+     * @param Dimensions dataset dimensions
+     * @param DataType (i.e. H5T_IEEE_F32BE, H5T_STD_I32LE, ...)
+     * @param Sources source datasets and the hyperslabs they map to (each source dataset has dimensions Count)
+     */
+    public: void create_virtual_dataset(const std::string Datasetname, const std::vector<hsize_t> Dimensions,
+                                        const hid_t DataType, const std::vector<NameSpaceHDFIO::VirtualSource> Sources)
+    {
+#if H5_VERSION_GE(1,10,0)
+        this->setDims(Dimensions); // set dimensions
+
+        // -------------- create dataspace
+        Dataspace_id = H5Screate_simple(Rank, HDFDims, NULL);
+        assert( Dataspace_id != HDF5_error );
+
+        // -------------- map the sources
+        hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+        for (unsigned int i = 0; i < Sources.size(); i++) {
+            assert( ((int)Sources[i].Offset.size() == Rank) && ((int)Sources[i].Count.size() == Rank) );
+            hid_t Srcspace_id = H5Screate_simple(Rank, &Sources[i].Count[0], NULL);
+            assert( Srcspace_id != HDF5_error );
+            HDF5_status = H5Sselect_hyperslab(Dataspace_id, H5S_SELECT_SET, &Sources[i].Offset[0], NULL, &Sources[i].Count[0], NULL);
+            assert( HDF5_status != HDF5_error );
+            HDF5_status = H5Pset_virtual(dcpl_id, Dataspace_id, Sources[i].Filename.c_str(), Sources[i].Datasetname.c_str(), Srcspace_id);
+            assert( HDF5_status != HDF5_error );
+            HDF5_status = H5Sclose(Srcspace_id);
+            assert( HDF5_status != HDF5_error );
+        }
+        H5Sselect_all(Dataspace_id);
+
+        // -------------- create dataset
+        Dataset_id = H5Dcreate(File_id, Datasetname.c_str(), DataType, Dataspace_id, H5P_DEFAULT, dcpl_id, H5P_DEFAULT);
+        assert( Dataset_id != HDF5_error );
+        H5Pclose(dcpl_id);
+
+        // -------------- close dataset
+        HDF5_status = H5Dclose(Dataset_id);
+        assert( HDF5_status != HDF5_error );
+
+        // -------------- close dataspace
+        HDF5_status = H5Sclose(Dataspace_id);
+        assert( HDF5_status != HDF5_error );
+#else
+        std::cout<<ClassSignature<<"create_virtual_dataset: ERROR: virtual datasets require HDF5 >= 1.10; '"
+                 <<Datasetname<<"' not created."<<std::endl;
+#endif
+    };
+
     /**
      * delete HDF5 dataset
      * @param Datasetname datasetname
@@ -725,6 +970,7 @@ class HDFIO
             if (dsets_in_file[i] == Datasetname) { dset_in_file = true; break; }
         }
         if (dset_in_file) { // if the Datasetname is in the file, delete it
+            this->close_handle(Datasetname); // cached handle
             HDF5_status = H5Ldelete(File_id, Datasetname.c_str(), H5P_DEFAULT); // delete dataset
             assert( HDF5_status != HDF5_error );
         }
@@ -770,10 +1016,28 @@ class HDFIO
     };
 
     public: void setDims(const std::vector<int> Dimensions)
+    {
+        this->setDims(this->toHDFDims(Dimensions));
+    };
+
+    public: void setDims(const std::vector<hsize_t> Dimensions)
     {
         Rank = Dimensions.size();
         for(int i = 0; i < Rank; i++)
-            HDFDims[i] = static_cast<hsize_t>(Dimensions[i]);
+            HDFDims[i] = Dimensions[i];
+    };
+
+    /**
+     * convert int dimensions to HDF5 (64-bit) dimensions
+     * @param Dimensions dimensions
+     * @return dimensions as hsize_t
+     */
+    private: std::vector<hsize_t> toHDFDims(const std::vector<int> Dimensions) const
+    {
+        std::vector<hsize_t> ReturnDims(Dimensions.size());
+        for (unsigned int i = 0; i < Dimensions.size(); i++)
+            ReturnDims[i] = static_cast<hsize_t>(Dimensions[i]);
+        return ReturnDims;
     };
 
     /**
@@ -819,9 +1083,9 @@ class HDFIO
     /**
      * get dataset size of dataset with datasetname
      * @param Datasetname datasetname
-     * @return size of the dataset
+     * @return size of the dataset (64-bit)
      */
-    public: int getSize(const std::string Datasetname)
+    public: long getSize(const std::string Datasetname)
     {
         // open dataset
         Dataset_id = H5Dopen(File_id, Datasetname.c_str(), H5P_DEFAULT);
@@ -854,7 +1118,7 @@ class HDFIO
         HDF5_status = H5Dclose(Dataset_id);
         assert( HDF5_status != HDF5_error );
 
-        return static_cast<int>(HDFSize);
+        return static_cast<long>(HDFSize);
     }; // getSize
 
     /**
@@ -1059,5 +1323,51 @@ class HDFIO
         H5Tclose(datatype); H5Tclose(h5string); H5Sclose(spaceId); H5Dclose(dsetId);
     };
 
+    // ************************************************************************* //
+    // ************** writing FLASH scalars or runtime parameters ************** //
+    // ************************************************************************* //
+    /// writes a batch of named integer, real, logical, string scalars or runtime parameters as one table (compound
+    /// dataset of name, value), in a single (collective) write instead of one dataset per scalar; read with ReadFlash*
+    public: void WriteFlashIntegerScalars(std::map<std::string, int> props, MPI_Comm comm)
+    { WriteFLASHProps("integer scalars", props, comm); };
+    public: void WriteFlashIntegerParameters(std::map<std::string, int> props, MPI_Comm comm)
+    { WriteFLASHProps("integer runtime parameters", props, comm); };
+    public: void WriteFlashRealScalars(std::map<std::string, double> props, MPI_Comm comm)
+    { WriteFLASHProps("real scalars", props, comm); };
+    public: void WriteFlashRealParameters(std::map<std::string, double> props, MPI_Comm comm)
+    { WriteFLASHProps("real runtime parameters", props, comm); };
+    public: void WriteFlashLogicalScalars(std::map<std::string, bool> props, MPI_Comm comm)
+    { WriteFLASHProps("logical scalars", props, comm); };
+    public: void WriteFlashLogicalParameters(std::map<std::string, bool> props, MPI_Comm comm)
+    { WriteFLASHProps("logical runtime parameters", props, comm); };
+    public: void WriteFlashStringScalars(std::map<std::string, std::string> props, MPI_Comm comm)
+    { WriteFLASHProps("string scalars", props, comm); };
+    public: void WriteFlashStringParameters(std::map<std::string, std::string> props, MPI_Comm comm)
+    { WriteFLASHProps("string runtime parameters", props, comm); };
+    // write FLASH integer, real, logical, string scalars or runtime parameters (all cores in comm pass the same props)
+    private: template<typename T> void WriteFLASHProps(std::string datasetname, std::map<std::string, T> props, MPI_Comm comm)
+    {
+        int num = props.size();
+        hid_t h5string = H5Tcopy(H5T_C_S1); H5Tset_size(h5string, NameSpaceHDFIO::flash_str_len); hid_t dtype;
+        if (typeid(T) == typeid(int))         dtype = H5T_NATIVE_INT;
+        if (typeid(T) == typeid(double))      dtype = H5T_NATIVE_DOUBLE;
+        if (typeid(T) == typeid(bool))        dtype = H5T_NATIVE_HBOOL;
+        if (typeid(T) == typeid(std::string)) dtype = H5Tcopy(h5string);
+        hid_t datatype = H5Tcreate(H5T_COMPOUND, sizeof(NameSpaceHDFIO::FlashScalarsParametersStruct<T>));
+        H5Tinsert(datatype, "name", HOFFSET(NameSpaceHDFIO::FlashScalarsParametersStruct<T>, name), h5string);
+        H5Tinsert(datatype, "value", HOFFSET(NameSpaceHDFIO::FlashScalarsParametersStruct<T>, value), dtype);
+        NameSpaceHDFIO::FlashScalarsParametersStruct<T> *data = new NameSpaceHDFIO::FlashScalarsParametersStruct<T>[num];
+        memset(data, 0, num*sizeof(NameSpaceHDFIO::FlashScalarsParametersStruct<T>));
+        int i = 0;
+        for (typename std::map<std::string, T>::iterator it = props.begin(); it != props.end(); it++, i++) {
+            strncpy(data[i].name, it->first.c_str(), NameSpaceHDFIO::flash_str_len-1);
+            NameSpaceHDFIO::FLASHPropAssign<T>(it->second, &data[i].value);
+            if (Verbose > 1) std::cout<<FuncSig(__func__)<<"name, value = '"<<it->first<<"', '"<<it->second<<"'"<<std::endl;
+        }
+        this->write(data, datasetname, std::vector<hsize_t>(1, num), datatype, comm); delete [] data;
+        H5Tclose(datatype); H5Tclose(h5string);
+        if (typeid(T) == typeid(std::string)) H5Tclose(dtype); // the copy of h5string (the native types must not be closed)
+    };
+
 }; // end: HDFIO
 #endif
@@ -7,9 +7,15 @@
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <fstream>
 #include <cstdio>
 #include <cstdlib>
 #include <cmath>
+#include <algorithm>
+#include <map>
+#include <functional>
+#include <fcntl.h>
+#include <unistd.h>
 #include "TurbGen.h"
 
 // normally set via compiler defines: #define HAVE_HDF5
@@ -20,7 +26,7 @@
 // normally set via compiler defines: #define HAVE_MPI
 #ifdef HAVE_MPI
 #include "mpi.h"
-#define MPI_COMM MPI_COMM_WORLD
+#define MPI_COMM group_comm // communicator of the cores generating the same realisation(s)
 #else
 #ifndef MPI_COMM_NULL
 #define MPI_COMM_NULL 0
@@ -36,6 +42,10 @@ static const string ProgSign = "TurbGen.cpp: ";
 int verbose = 1; // 0: all standard output off (quiet mode)
 double ndim = 3; // dimensionality (must be 1 or 1.5 or 2 or 2.5 or 3)
 int N[3] = {64, 64, 64}; // number of cells in turbulent output field in x, y, z
+int chunk_nz = 0; // if > 0: stream the field in chunks of chunk_nz cells in z (bounds memory independent of N)
+bool pipeline = false; // if streaming: overlap computing a chunk with the file I/O of the previous chunk (I/O thread)
+int decomp[3] = {0, 1, 1}; // number of cores along x, y, z for the domain decomposition (0: automatic, e.g., {0, 0, 1} for pencils)
+bool decomp_set = false; // whether decomp was set with -decomp (otherwise, the default slabs become blocks if NPE > N[X])
 double L[3] = {1.0, 1.0, 1.0}; // size of box in x, y, z
 double k_min = 2.0;  // minimum wavenumber for turbulent field (in units of 2pi / L[X])
 double k_max = 20.0; // minimum wavenumber for turbulent field (in units of 2pi / L[X])
@@ -49,11 +59,39 @@ double angles_exp = 1.0; // if spect_form == 2: spectral sampling of angles;
                          // For full sampling, angles_exp = 2.0; for healpix-type sampling, angles_exp = 0.0.
 double sol_weight = 0.5; // solenoidal weight: 1.0: solenoidal driving, 0.0: compressive driving, 0.5: natural mixture
 int random_seed = 140281; // random seed for this turbulent realisation
+int seed_first = 0, seed_last = -1; // if seed_last >= seed_first: ensemble of realisations with random seeds seed_first..seed_last
+int nrealisations = 0; // if > 1: ensemble of realisations with random seeds random_seed..random_seed+nrealisations-1
+int ensemble_batch = 4; // ensemble (spect_form 0, 1): number of realisations evaluated per pass over the mode tables
+int ensemble_groups = 0; // ensemble (MPI): number of groups of cores, each generating a subset of the realisations (0: automatic)
 string outfilename = "TurbGen_output.h5"; // HDF5 output filename
+bool h5_chunks = false; // use a chunked HDF5 layout for turb_field_*, with chunks aligned to the domain decomposition
+int compress_level = 0; // if > 0: shuffle + deflate (gzip) compression of turb_field_* with this level (1-9)
+int scale_offset = -1; // if >= 0: scale-offset filter (lossy) for turb_field_*, keeping this many decimal digits
+long io_alignment = 0; // if > 0: align HDF5 datasets of at least this size to multiples of this many bytes (e.g., the stripe size)
+long io_mdc_size = 0; // if > 0: HDF5 metadata cache size in bytes
+bool io_coll_metadata = false; // if parallel HDF5: collective metadata reads and writes
+int io_cb_nodes = 0; // if > 0: MPI-IO hint cb_nodes (number of collective-buffering aggregators)
+long io_cb_buffer_size = 0; // if > 0: MPI-IO hint cb_buffer_size (collective-buffering buffer size in bytes)
+int io_striping_factor = 0; // if > 0: MPI-IO hint striping_factor (stripe count of the output file)
+long io_striping_unit = 0; // if > 0: MPI-IO hint striping_unit (stripe size in bytes of the output file)
+bool raw_output = false; // write raw binary files (little-endian float32, one per component) and a JSON sidecar instead of HDF5
+int file_per = 0; // 0: one shared output file; 1: one file per core; 2: one file per node (written by its first core);
+                  // for 1 and 2, the output file contains virtual datasets (HDF5 >= 1.10) that stitch the pieces together
 bool write_modes = false; // switch to write Fourier modes and amplitudes to output file
+double truncation_taper = -1.0; // if >= 0: only evaluate modes resolved by the grid, with this relative taper width
+int angles_sampling = 0; // if spect_form == 2: 0: random angles, 1: Fibonacci sphere with random rotation per k-shell
+int max_nmodes = 0; // if spect_form == 2 and > 0: maximum number of modes (reduces the number of angles per k-shell)
+double eval_time = 0.0; // if spect_form == 2 and > 0: target time (s) for evaluating the field on each core
+bool mpi_shared_modes = false; // if MPI: place the mode table into node-shared memory (MPI-3)
+bool merge_modes = false; // if spect_form == 2: merge sampled modes that land on the same lattice vector (+/-k)
+double interpolation_tolerance = 0.0; // if > 0: evaluate on a coarser grid and interpolate, with this relative error tolerance
 
 // MPI stuff
 int MyPE = 0, NPE = 1;
+#ifdef HAVE_MPI
+MPI_Comm group_comm = MPI_COMM_WORLD; // ensemble: the cores of this group (sub-communicator of MPI_COMM_WORLD)
+#endif
+int mpi_thread_level = 0; // thread support provided by MPI (MPI_THREAD_SERIALIZED needed for the I/O thread of -pipeline)
 
 // forward functions
 int ParseInputs(const vector<string> Argument);
@@ -64,7 +102,7 @@ int main(int argc, char * argv[])
 {
     /// initialise MPI
 #ifdef HAVE_MPI
-    MPI_Init(&argc, &argv);
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_SERIALIZED, &mpi_thread_level);
     MPI_Comm_size(MPI_COMM_WORLD, &NPE);
     MPI_Comm_rank(MPI_COMM_WORLD, &MyPE);
 #endif
@@ -84,14 +122,63 @@ int main(int argc, char * argv[])
 
     if (MyPE==0 && verbose>1) cout<<ProgSign+"started..."<<endl;
 
+    // set dimensionality dependencies
+    if ((int)ndim < 3) { N[Z] = 1; L[Z] = 1.0; decomp[Z] = 1; } // 2D
+    if ((int)ndim < 2) { N[Y] = 1; L[Y] = 1.0; decomp[Y] = 1; } // 1D
+
+    // ensemble of realisations (-seeds, -nrealisations): the cores are split into ngroups groups (MPI sub-communicators),
+    // and group g generates the realisations g, g+ngroups, ..., each decomposed over the cores of the group
+    vector<int> seeds(1, random_seed);
+    if (seed_last >= seed_first) { seeds.clear(); for (int s = seed_first; s <= seed_last; s++) seeds.push_back(s); }
+    else if (nrealisations > 1) { seeds.clear(); for (int s = 0; s < nrealisations; s++) seeds.push_back(random_seed+s); }
+    const int nseeds = seeds.size();
+    const bool ensemble = (nseeds > 1);
+    int ngroups = 1, group = 0;
 #ifdef HAVE_MPI
-    // stop on error in domain decomposition if we run with MPI and number cores is > number of grid cells in X
-    if (NPE > N[X]) {
-        if (MyPE==0 && verbose>0) cout<<ProgSign+"Error in domain decomposition: NPE must be <= N[X]"<<endl;
-        MPI_Finalize();
-        return -1;
+    if (ensemble) {
+        ngroups = (ensemble_groups > 0) ? ensemble_groups : nseeds;
+        ngroups = max(1, min(ngroups, min(NPE, nseeds)));
+        group = MyPE * ngroups / NPE;
+        MPI_Comm_split(MPI_COMM_WORLD, group, MyPE, &group_comm);
+        MPI_Comm_size(group_comm, &NPE);
+        MPI_Comm_rank(group_comm, &MyPE);
+        if (group > 0) verbose = 0; // only the first group reports
     }
 #endif
+    if (ensemble && MyPE==0 && verbose>0) // first core of the first group
+        cout<<ProgSign+"Ensemble of "<<nseeds<<" realisations (random seeds "<<seeds[0]<<", ..., "<<seeds[nseeds-1]<<"), generated by "
+            <<ngroups<<" group(s) of cores."<<endl;
+    vector<int> my_seeds; // random seeds of the realisations generated by this group
+    for (int i = group; i < nseeds; i += ngroups) my_seeds.push_back(seeds[i]);
+
+    // Cartesian domain decomposition into decomp[X]*decomp[Y]*decomp[Z] = NPE blocks (slabs, pencils, or cubes);
+    // each core gets N[d]/decomp[d] cells in direction d, plus one for the first N[d]%decomp[d] cores along d
+#ifdef HAVE_MPI
+    if (!decomp_set && (NPE > N[X])) { // default x-slabs would be empty; decompose all directions (as with -decomp 0 0 0)
+        decomp[X] = 0;
+        if ((int)ndim > 1) decomp[Y] = 0;
+        if ((int)ndim > 2) decomp[Z] = 0;
+    }
+    int decomp_fixed = 1; for (int d = 0; d < 3; d++) if (decomp[d] > 0) decomp_fixed *= decomp[d];
+    if (NPE % decomp_fixed == 0) MPI_Dims_create(NPE, 3, decomp); // fill in the directions with decomp[d] = 0
+#else
+    for (int d = 0; d < 3; d++) decomp[d] = 1;
+#endif
+    int coord[3] = {MyPE % decomp[X], (MyPE / decomp[X]) % decomp[Y], MyPE / (decomp[X]*decomp[Y])}; // x fastest
+    int N_out[3], offset_out[3]; // number of cells and offset (first global cell index) of MyPE
+    for (int d = 0; d < 3; d++) {
+        if ((decomp[d] < 1) || (decomp[d] > N[d]) || (decomp[X]*decomp[Y]*decomp[Z] != NPE)) {
+            if (MyPE==0 && verbose>0) cout<<ProgSign+"Error in domain decomposition: need decomp[X]*decomp[Y]*decomp[Z] = NPE and 1 <= decomp[d] <= N[d]"
+                                          <<" (e.g., -decomp 0 0 0 for an automatic decomposition in all directions)"<<endl;
+#ifdef HAVE_MPI
+            MPI_Finalize();
+#endif
+            return -1;
+        }
+        int div = N[d] / decomp[d], mod = N[d] % decomp[d];
+        N_out[d] = div + (coord[d] < mod ? 1 : 0);
+        offset_out[d] = coord[d] * div + min(coord[d], mod);
+    }
 
     long starttime = time(NULL);
     cout<<setprecision(9);
@@ -99,217 +186,690 @@ int main(int argc, char * argv[])
     // create TurbGen class object
     TurbGen tg = TurbGen(MyPE);
     tg.set_verbose(verbose);
+#ifdef HAVE_MPI
+    tg.set_mpi_comm(MPI_COMM, mpi_shared_modes); // generate modes on rank 0 and broadcast
+#endif
+    if (truncation_taper >= 0.0) tg.set_mode_truncation(true, truncation_taper);
+    if (merge_modes) tg.set_merge_duplicate_modes(true);
+    if (angles_sampling != 0) tg.set_angles_sampling(angles_sampling);
+    if (max_nmodes > 0) tg.set_mode_budget(max_nmodes);
+    if (eval_time > 0.0) tg.set_mode_budget(eval_time, N_out); // budget for the cells of each core
 
     // initialise generator to return a single turbulent realisation based on input parameters
-    tg.init_single_realisation(ndim, L, k_min, k_mid, k_max, spect_form, power_law_exp, power_law_exp_2, angles_exp, sol_weight, random_seed);
+    // (in ensemble mode, the first realisation of this group of cores)
+    tg.init_single_realisation(ndim, L, k_min, k_mid, k_max, spect_form, power_law_exp, power_law_exp_2, angles_exp, sol_weight, my_seeds[0]);
 
     // get the number of vector field components
     int ncmp = tg.get_number_of_components();
 
-    // set dimensionality dependencies
-    if ((int)ndim < 3) { N[Z] = 1; L[Z] = 1.0; } // 2D
-    if ((int)ndim < 2) { N[Y] = 1; L[Y] = 1.0; } // 1D
-
     // define cell size of uniform grid
     double del[3];
     for (int d = 0; d < 3; d++) del[d] = L[d] / N[d];
 
     // always generate within [0,L], cell-centered; user can shift output to target physical location, if needed
     double pos_beg[3] = {0.0, 0.0, 0.0}, pos_end[3] = {0.0, 0.0, 0.0}; // start and end coordinates of output grid
-    // parallelise along X (generalises to non-MPI case, where NPE=1 and MyPE=0)
-    int divN_PE = ceil((double)N[X]/(double)NPE);
-    int NPE_main = N[X] / divN_PE;
-    int modN_PE = N[X] - NPE_main * divN_PE;
-    double divL_PE = L[X] * (double)divN_PE / (double)N[X];
-    double modL_PE = L[X] * (double)modN_PE / (double)N[X];
-    int NPE_in_use = NPE_main; if (modN_PE > 0) NPE_in_use += 1;
-    int NX = 0; // number of cells in X for MyPE (idle PEs get nothing, i.e., NX=0)
-    if (MyPE==0 && verbose>1)
-        cout<<ProgSign+"NPE_main, divN_PE, modN_PE, divL_PE, modL_PE = "<<NPE_main<<" "<<divN_PE<<" "<<modN_PE<<" "<<divL_PE<<" "<<modL_PE<<endl;
-    // set pos_beg and pos_end
     for (int d = 0; d < 3; d++) {
-        if (d==X) { // parallelised direction - x
-            if (MyPE < NPE_main) { // equally distribute to NPE_main cores
-                pos_beg[d] = MyPE*divL_PE + del[d]/2.0; // first cell coordinate (cell center)
-                pos_end[d] = (MyPE+1)*divL_PE - del[d]/2.0; // last cell coordinate (cell center)
-                NX = divN_PE;
-            } else if (MyPE < NPE_in_use) { // last PE gets the rest (idle PEs get nothing, i.e., NX=0)
-                pos_beg[d] = NPE_main*divL_PE + del[d]/2.0; // first cell coordinate (cell center)
-                pos_end[d] = L[X] - del[d]/2.0; // last cell coordinate (cell center)
-                NX = modN_PE;
-            }
-            if (verbose>1)
-                cout<<ProgSign+"MyPE, pos_beg[X], pos_beg[X], NX = "<<MyPE<<" "<<pos_beg[X]<<" "<<pos_end[X]<<" "<<NX<<endl;
-        } else { // non-parallelised direction(s)
-            pos_beg[d] = del[d]/2.0; // first cell coordinate (cell center)
-            pos_end[d] = L[d] - del[d]/2.0; // last cell coordinate (cell center)
-        }
+        pos_beg[d] = L[d] * (double)offset_out[d] / (double)N[d] + del[d]/2.0; // first cell coordinate (cell center)
+        pos_end[d] = L[d] * (double)(offset_out[d]+N_out[d]) / (double)N[d] - del[d]/2.0; // last cell coordinate (cell center)
+    }
+    // start and end coordinates, and number of cells (64-bit) of the global grid
+    double pos_beg_global[3], pos_end_global[3]; long N_global[3];
+    for (int d = 0; d < 3; d++) {
+        pos_beg_global[d] = del[d]/2.0;
+        pos_end_global[d] = L[d] - del[d]/2.0;
+        N_global[d] = N[d];
     }
+    if (verbose>1)
+        cout<<ProgSign+"MyPE, offset, N_out = "<<MyPE<<" "<<offset_out[X]<<" "<<offset_out[Y]<<" "<<offset_out[Z]<<" "
+            <<N_out[X]<<" "<<N_out[Y]<<" "<<N_out[Z]<<endl;
 
 #ifdef HAVE_MPI
     if (MyPE==0 && verbose>0) {
-        cout<<ProgSign+"First "<<NPE_main<<" core(s) carry(ies) NX="<<divN_PE<<" cell(s) (each)."<<endl;
-        if (modN_PE > 0) cout<<ProgSign+"Core #"<<NPE_main+1<<" carries NX="<<modN_PE<<" cell(s)."<<endl;
-        if (NPE_in_use < NPE) cout<<ProgSign+"Warning: non-optimal load balancing; "<<NPE-NPE_in_use<<" core(s) remain(s) idle."<<endl;
+        cout<<ProgSign+"Domain decomposition into "<<decomp[X]<<" x "<<decomp[Y]<<" x "<<decomp[Z]<<" blocks of up to "
+            <<(N[X]+decomp[X]-1)/decomp[X]<<" x "<<(N[Y]+decomp[Y]-1)/decomp[Y]<<" x "<<(N[Z]+decomp[Z]-1)/decomp[Z]<<" cells."<<endl;
     }
 #endif
 
-    // total number of output grid cells
-    int N_out[3] = {NX, N[Y], N[Z]};
-    long ntot = 1; for (int d = 0; d < 3; d++) ntot *= N_out[d];
-    // output grid, which receives the turbulent field (up to ndim = 3)
-    float * grid_out[3];
+    // number of cells in z generated (and held in memory) at a time; the whole local block unless streaming (-chunk_nz)
+    int nz_chunk = N_out[Z];
+    if (chunk_nz > 0) nz_chunk = max(1, min(chunk_nz, N_out[Z]));
+    // number of chunks (the same on all cores, as the HDF5 slab writes are collective)
+    int nchunks = (N_out[Z] + nz_chunk - 1) / nz_chunk;
+#ifdef HAVE_MPI
+    MPI_Allreduce(MPI_IN_PLACE, &nchunks, 1, MPI_INT, MPI_MAX, MPI_COMM);
+#endif
+    // number of output grid cells (per chunk)
+    long ntot = 1; for (int d = 0; d < 3; d++) ntot *= (d==Z ? nz_chunk : N_out[d]);
+    // pipelining (double buffering): the field of a chunk is computed into one grid, while an I/O thread writes
+    // (or reads) the previous (or next) chunk from the other; the I/O thread is the only one calling HDF5 and MPI then
+    bool pipelined = pipeline && (nchunks > 1);
+#ifndef HAVE_THREADS
+    pipelined = false;
+    if (pipeline && MyPE==0 && verbose>0) cout<<ProgSign+"WARNING: -pipeline requires HAVE_THREADS; ignored."<<endl;
+#endif
+#ifdef HAVE_MPI
+    if (pipelined && (mpi_thread_level < MPI_THREAD_SERIALIZED)) {
+        if (MyPE==0 && verbose>0) cout<<ProgSign+"WARNING: -pipeline requires MPI_THREAD_SERIALIZED; writing without pipelining."<<endl;
+        pipelined = false;
+    }
+#endif
+    if (pipeline && (nchunks == 1) && MyPE==0 && verbose>0)
+        cout<<ProgSign+"WARNING: -pipeline only overlaps computing and I/O of streamed chunks (see -chunk_nz); ignored."<<endl;
+    const int nbuf = pipelined ? 2 : 1;
+    // ensemble mode: with spect_form 0 and 1, all random seeds share the modes, so the realisations are generated in
+    // batches of up to ensemble_batch, evaluated in one pass over the mode tables; else one realisation at a time,
+    // re-initialising the generator for each seed (the modes of spect_form 2 depend on the seed)
+    const bool shared_modes = ensemble && (spect_form != 2) && (interpolation_tolerance <= 0.0);
+    const int nbatch = shared_modes ? max(1, min(ensemble_batch, (int)my_seeds.size())) : 1;
+    if (MyPE==0 && verbose>0 && ensemble)
+        cout<<ProgSign+"Generating "<<(shared_modes ? "up to "+to_string(nbatch)+" realisations per pass over the mode tables (shared modes)."
+                                                    : "one realisation at a time (the modes depend on the random seed).")<<endl;
+    // output grid(s), which receive the turbulent field (up to ndim = 3), for each realisation of a batch
+    vector<float *> grid_out(2*nbatch*3, (float *)NULL);
+    auto grids = [&](const int b, const int r) { return &grid_out[3*(b*nbatch+r)]; }; // grids of buffer b, realisation r
     // allocate
-    for (int d = 0; d < ncmp; d++) grid_out[d] = new float[ntot];
+    for (int b = 0; b < nbuf; b++) for (int r = 0; r < nbatch; r++) for (int d = 0; d < ncmp; d++) grids(b, r)[d] = new float[ntot];
+    if (MyPE==0 && verbose>0 && nchunks > 1)
+        cout<<ProgSign+"Streaming the field in "<<nchunks<<" chunks of up to "<<nz_chunk<<" cells in z"
+            <<(pipelined ? " (pipelined: computing overlaps with I/O)." : ".")<<endl;
 
-    // call to return uniform grid(s) with ncmp components of the turbulent field at requested positions
-    tg.get_turb_vector_unigrid(pos_beg, pos_end, N_out, grid_out);
+    if (MyPE==0 && (verbose>1 || (verbose>0 && (eval_time > 0.0 || max_nmodes > 0))))
+        cout<<ProgSign+"Estimated evaluation time: "<<tg.get_estimated_evaluation_time(N_out)<<" s"<<endl;
 
-    // compute mean and std of generated turbulent field and then re-normalise to mean=0 and std=1
-    double mean [3] = {0.0, 0.0, 0.0};
-    double mean2[3] = {0.0, 0.0, 0.0};
-    double std[3] = {0.0, 0.0, 0.0};
-    for (int d = 0; d < ncmp; d++) {
-        for (long ni = 0; ni < ntot; ni++) {
-            mean [d] += grid_out[d][ni];
-            mean2[d] += pow(grid_out[d][ni],2.0);
-        }
-    }
-#ifdef HAVE_MPI
-    MPI_Allreduce(MPI_IN_PLACE, mean , 3, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
-    MPI_Allreduce(MPI_IN_PLACE, mean2, 3, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+#ifndef HAVE_HDF5
+    raw_output = true; // without HDF5, the field goes into raw binary files
 #endif
-    for (int d = 0; d < ncmp; d++) {
-        mean [d] /= N[X]*N[Y]*N[Z]; // mean
-        mean2[d] /= N[X]*N[Y]*N[Z]; // mean squared
-        std[d] = sqrt(mean2[d] - mean[d]*mean[d]); // standard deviation
-        for (long ni = 0; ni < ntot; ni++) {
-            grid_out[d][ni] -= mean[d];
-            grid_out[d][ni] /= std[d];
-        }
+    if (raw_output && (file_per > 0)) {
+        if (MyPE==0 && verbose>0) cout<<ProgSign+"WARNING: -file_per only applies to HDF5 output; writing shared raw files."<<endl;
+        file_per = 0;
     }
+    string dsetnames[3] = {"turb_field_x", "turb_field_y", "turb_field_z"};
+    string out_base = outfilename; // output filename without extension .h5 (base of the raw files and of the pieces)
+    if ((out_base.size() > 3) && (out_base.substr(out_base.size()-3) == ".h5")) out_base = out_base.substr(0, out_base.size()-3);
 
-    // re-compute mean and std
-    for (int d = 0; d < ncmp; d++) {
-        mean[d] = 0.0; mean2[d] = 0.0;
-        for (long ni = 0; ni < ntot; ni++) {
-            mean [d] += grid_out[d][ni];
-            mean2[d] += pow(grid_out[d][ni],2.0);
+    // output of a realisation: output file (or raw files) and its pieces; in ensemble mode, one per random seed
+    struct Output {
+        int seed; // random seed of the realisation
+        string filename, base; // output filename, and its base (without extension .h5)
+        string rawfilenames[3]; // raw output
+        int raw_fd[3];
+#ifdef HAVE_HDF5
+        HDFIO hdfio, hdfio_piece; // HDF5 output file, and piece file (file_per > 0)
+#endif
+    };
+    vector<Output> out(nbatch);
+
+    // raw binary output: one file per component, with x as the inner and z as the outer index (like turb_field_* in the
+    // HDF5 file), which the cores write (and read back, when streaming) at the offsets of their rows with pwrite (pread)
+    bool little_endian = true;
+    { const unsigned short one = 1; little_endian = (*(const unsigned char *)&one == 1); }
+    auto create_raw_output = [&](Output & o) {
+        const off_t raw_size = (off_t)sizeof(float) * N[X] * N[Y] * N[Z];
+        if (MyPE == 0) for (int dc = 0; dc < ncmp; dc++) { // create (truncate) and size the files
+            int fd = open(o.rawfilenames[dc].c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if ((fd < 0) || (ftruncate(fd, raw_size) != 0)) {
+                cout<<ProgSign+"ERROR: cannot create '"<<o.rawfilenames[dc]<<"'."<<endl;
+                exit(-1);
+            }
+            close(fd);
         }
-    }
 #ifdef HAVE_MPI
-    MPI_Allreduce(MPI_IN_PLACE, mean , 3, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
-    MPI_Allreduce(MPI_IN_PLACE, mean2, 3, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+        MPI_Barrier(MPI_COMM);
 #endif
-    for (int d = 0; d < ncmp; d++) {
-        mean [d] /= N[X]*N[Y]*N[Z]; // mean
-        mean2[d] /= N[X]*N[Y]*N[Z]; // mean squared
-        std[d] = sqrt(mean2[d] - mean[d]*mean[d]); // standard deviation
-    }
-
-    if (MyPE==0 && verbose>0) {
-        cout<<ProgSign+"Generated "<<ndim<<"D turbulent field with"<<endl;
-        cout<<ProgSign+" number of grid cells N ="; for (int d = 0; d < (int)ndim; d++) cout<<" "<<N[d]; cout<<endl;
-        cout<<ProgSign+" physical size L ="; for (int d = 0; d < (int)ndim; d++) cout<<" "<<L[d]; cout<<endl;
-        cout<<ProgSign+" mean (for each component) ="; for (int d = 0; d < ncmp; d++) cout<<" "<<mean[d]; cout<<endl;
-        cout<<ProgSign+" 1D standard deviation (for each component) ="; for (int d = 0; d < ncmp; d++) cout<<" "<<std[d]; cout<<endl;
-        string expected = "";
-        if (ncmp==1) expected = "1";
-        if (ncmp==2) expected = "sqrt(2)";
-        if (ncmp==3) expected = "sqrt(3)";
-        cout<<ProgSign+" total ("<<ndim<<"D) standard deviation (expected: "<<expected<<") = "<<sqrt(std[0]*std[0]+std[1]*std[1]+std[2]*std[2])<<endl;
-    }
+        for (int dc = 0; dc < ncmp; dc++) {
+            o.raw_fd[dc] = open(o.rawfilenames[dc].c_str(), O_RDWR);
+            if (o.raw_fd[dc] < 0) { cout<<ProgSign+"ERROR: cannot open '"<<o.rawfilenames[dc]<<"'."<<endl; exit(-1); }
+        }
+    };
+    // read or write nbytes at offset of a raw file (in pieces, as pread/pwrite may transfer fewer bytes), as little endian
+    auto raw_transfer = [&](const int fd, float * buf, const long n, const off_t offset, const bool read) {
+        vector<float> swapped; // byte-swapped copy on big-endian machines
+        char * ptr = (char *)buf;
+        if (!little_endian && !read) {
+            swapped.assign(buf, buf+n); ptr = (char *)&swapped[0];
+            for (long i = 0; i < n; i++) std::reverse(ptr+i*sizeof(float), ptr+(i+1)*sizeof(float));
+        }
+        const long nbytes = n * (long)sizeof(float);
+        for (long done = 0; done < nbytes; ) {
+            ssize_t ret = read ? pread(fd, ptr+done, nbytes-done, offset+done) : pwrite(fd, ptr+done, nbytes-done, offset+done);
+            if (ret <= 0) { cout<<ProgSign+"ERROR: raw file I/O failed."<<endl; exit(-1); }
+            done += ret;
+        }
+        if (!little_endian && read) for (long i = 0; i < n; i++) std::reverse(ptr+i*sizeof(float), ptr+(i+1)*sizeof(float));
+    };
+    // read or write chunk ic of component dc (in grid) from/to the raw file, with one transfer per contiguous run of cells
+    auto raw_access_chunk = [&](Output & o, const int ic, const int dc, const bool read, float * grid) {
+        const int z0 = min(ic*nz_chunk, N_out[Z]), nz = min(nz_chunk, N_out[Z]-z0);
+        long run = N_out[X]; int nj = N_out[Y], nk = nz; // cells per transfer, and number of transfers in y and z
+        if (N_out[X] == N[X]) { run *= N_out[Y]; nj = 1; if (N_out[Y] == N[Y]) { run *= nz; nk = 1; } }
+        for (int k = 0; k < nk; k++) for (int j = 0; j < nj; j++) {
+            const long cell = ((long)(offset_out[Z]+z0+k) * N[Y] + offset_out[Y]+j) * N[X] + offset_out[X]; // first cell in the file
+            raw_transfer(o.raw_fd[dc], &grid[((long)k*N_out[Y]+j)*N_out[X]], run, (off_t)cell*sizeof(float), read);
+        }
+    };
 
 #ifdef HAVE_HDF5
-    // write to HDF5 file
-    if (MyPE==0 && verbose>0) {
-        cout<<"-----------------------------------------------------"<<endl;
-        cout<<ProgSign+"Creating '"<<outfilename<<"' for output..."<<endl;
+    NameSpaceHDFIO::IOOptions io_options; // file system tuning (-io_* options)
+    io_options.alignment = io_alignment;
+    io_options.alignment_threshold = io_alignment; // only align the large datasets (turb_field_*), not the scalars
+    io_options.metadata_cache_size = io_mdc_size;
+    io_options.collective_metadata = io_coll_metadata;
+    io_options.cb_nodes = io_cb_nodes;
+    io_options.cb_buffer_size = io_cb_buffer_size;
+    io_options.striping_factor = io_striping_factor;
+    io_options.striping_unit = io_striping_unit;
+#ifndef H5_HAVE_PARALLEL
+    if ((NPE > 1) && (file_per == 0) && !raw_output) {
+        if (MyPE==0 && verbose>0) cout<<ProgSign+"HDF5 without parallel support: writing one file per core (-file_per rank)."<<endl;
+        file_per = 1;
     }
-    HDFIO hdfio = HDFIO();
-    hdfio.create(outfilename, MPI_COMM);
-    // write scalars
-    vector<int> hdf5dims(0);
-    hdfio.write(&ndim, "ndim", hdf5dims, H5T_NATIVE_DOUBLE, MPI_COMM);
-    hdfio.write(&ncmp, "ncmp", hdf5dims, H5T_NATIVE_INT, MPI_COMM);
-    hdfio.write(&k_min, "kmin", hdf5dims, H5T_NATIVE_DOUBLE, MPI_COMM);
-    hdfio.write(&k_mid, "kmid", hdf5dims, H5T_NATIVE_DOUBLE, MPI_COMM);
-    hdfio.write(&k_max, "kmax", hdf5dims, H5T_NATIVE_DOUBLE, MPI_COMM);
-    hdfio.write(&spect_form, "spect_form", hdf5dims, H5T_NATIVE_INT, MPI_COMM);
-    if (spect_form == 2) {
-        hdfio.write(&power_law_exp,   "power_law_exp",   hdf5dims, H5T_NATIVE_DOUBLE, MPI_COMM);
-        hdfio.write(&power_law_exp_2, "power_law_exp_2", hdf5dims, H5T_NATIVE_DOUBLE, MPI_COMM);
-        hdfio.write(&angles_exp, "angles_exp", hdf5dims, H5T_NATIVE_DOUBLE, MPI_COMM);
+#endif
+    // with file_per > 0, only the first core writes the output file (parameters and virtual datasets), and the field goes into the pieces
+    MPI_Comm out_comm = (file_per == 0) ? MPI_COMM : MPI_COMM_NULL; // communicator of the output file
+    const bool out_writer = (file_per == 0) || (MyPE == 0); // whether this core writes the output file
+    // dimensions of the datasets for the turbulent field (components)
+    vector<hsize_t> hdf5dims((int)ndim);
+    for (int d = 0; d < (int)ndim; d++) hdf5dims[(int)ndim-1-d] = N[d]; // order Z,Y,X
+    if (MyPE==0 && verbose>1) { cout<<ProgSign+"hdf5dims ="; for (int d = 0; d < (int)ndim; d++) cout<<" "<<hdf5dims[d]; cout<<endl; }
+    // chunked layout (required for the filters), with one chunk per core (or per streamed z-chunk), at most 2^26 cells each;
+    // the chunks are aligned with the slabs written by the cores, so that no two cores (or z-chunks) write into the same chunk
+    vector<hsize_t> h5chunkdims(0);
+    if (h5_chunks || compress_level > 0 || scale_offset >= 0) {
+        // greatest common divisor of all slab boundaries in direction d (block offsets of the cores, see the domain
+        // decomposition above, and the z-chunks within each block); chunks of this size (or a divisor) are aligned
+        auto gcd = [](long a, long b) { while (b > 0) { long t = a % b; a = b; b = t; } return a; };
+        long slab_gcd[3];
+        for (int d = 0; d < 3; d++) {
+            slab_gcd[d] = 0; // 0: a single slab (any chunk size is aligned)
+            const int div = N[d] / decomp[d], mod = N[d] % decomp[d];
+            for (int c = 0; c < decomp[d]; c++) {
+                const long off = (long)c * div + min(c, mod), ext = div + (c < mod ? 1 : 0);
+                const long step = ((d == Z) && (chunk_nz > 0)) ? max(1L, min((long)chunk_nz, ext)) : max(1L, ext);
+                for (long b = off; b < off+ext; b += step) slab_gcd[d] = gcd(b, slab_gcd[d]);
+            }
+        }
+        long chunk[3];
+        for (int d = 0; d < 3; d++) {
+            chunk[d] = (N[d] + decomp[d] - 1) / decomp[d];
+            if ((d == Z) && (nchunks > 1)) chunk[Z] = min((long)chunk_nz, chunk[Z]); // the same on all cores
+            // use the aligned size, unless it is much smaller (e.g., N not divisible by the number of cores)
+            if ((slab_gcd[d] > 0) && (4*slab_gcd[d] >= chunk[d])) chunk[d] = slab_gcd[d];
+        }
+        // limit the chunk size, dividing by a small factor of the chunk size where possible (keeps the alignment)
+        for (int d = Z; d >= X; d--) while (chunk[d] > 1 && chunk[X]*chunk[Y]*chunk[Z] > (1L<<26)) {
+            long f = 2; while ((f <= 7) && (chunk[d] % f != 0)) f++;
+            chunk[d] = (f <= 7) ? chunk[d] / f : (chunk[d] + 1) / 2;
+        }
+        bool aligned = true;
+        for (int d = 0; d < (int)ndim; d++) if (slab_gcd[d] % chunk[d] != 0) aligned = false;
+        h5chunkdims.resize((int)ndim); for (int d = 0; d < (int)ndim; d++) h5chunkdims[(int)ndim-1-d] = chunk[d]; // order Z,Y,X
+        if (MyPE==0 && verbose>0) {
+            cout<<ProgSign+"HDF5 chunks ="; for (int d = 0; d < (int)ndim; d++) cout<<" "<<h5chunkdims[d];
+            if (compress_level > 0) cout<<"; shuffle + deflate level "<<compress_level;
+            if (scale_offset >= 0) cout<<"; scale-offset with "<<scale_offset<<" decimal digits";
+            cout<<endl;
+            if (!aligned)
+                cout<<ProgSign+"WARNING: HDF5 chunks are not aligned with the blocks of the cores or the z-chunks (N not divisible by "
+                    <<"-decomp or -chunk_nz); several cores then write into the same chunk, which is slow with compression."<<endl;
+        }
     }
-    hdfio.write(&sol_weight, "sol_weight", hdf5dims, H5T_NATIVE_DOUBLE, MPI_COMM);
-    hdfio.write(&random_seed, "random_seed", hdf5dims, H5T_NATIVE_INT, MPI_COMM);
-    // write N and L vectors
-    hdf5dims.resize(1); hdf5dims[0] = (int)ndim;
-    int No[(int)ndim]; double Lo[(int)ndim]; // order Z,Y,X
-     for (int d = 0; d < (int)ndim; d++) {
-        No[(int)ndim-1-d] = N[d];
-        Lo[(int)ndim-1-d] = L[d];
+    // pieces (file_per > 0): block (N_out, offset_out) and nz_chunk of each core, and the core writing its piece (first core of its node)
+    vector<int> piece_info(8*NPE); // N_out[3], offset_out[3], nz_chunk, writer of each core
+    vector<int> node_cores(1, MyPE); // cores whose pieces this core writes (if it is a writer)
+    if (file_per > 0) {
+        int writer = MyPE;
+#ifdef HAVE_MPI
+#if MPI_VERSION >= 3
+        if (file_per == 2) {
+            MPI_Comm node_comm; int node_size;
+            MPI_Comm_split_type(MPI_COMM, MPI_COMM_TYPE_SHARED, MyPE, MPI_INFO_NULL, &node_comm);
+            MPI_Comm_size(node_comm, &node_size);
+            node_cores.resize(node_size);
+            MPI_Allgather(&MyPE, 1, MPI_INT, &node_cores[0], 1, MPI_INT, node_comm);
+            writer = node_cores[0];
+            MPI_Comm_free(&node_comm);
+        }
+#endif
+#endif
+        int info[8] = {N_out[X], N_out[Y], N_out[Z], offset_out[X], offset_out[Y], offset_out[Z], nz_chunk, writer};
+#ifdef HAVE_MPI
+        MPI_Allgather(info, 8, MPI_INT, &piece_info[0], 8, MPI_INT, MPI_COMM);
+#else
+        for (int i = 0; i < 8; i++) piece_info[i] = info[i];
+#endif
     }
-    hdfio.write(No, "N", hdf5dims, H5T_NATIVE_INT, MPI_COMM);
-    hdfio.write(Lo, "L", hdf5dims, H5T_NATIVE_DOUBLE, MPI_COMM);
-    // write turbulent field (components)
-    hdf5dims.resize((int)ndim); for (int d = 0; d < (int)ndim; d++) hdf5dims[(int)ndim-1-d] = N[d]; // order Z,Y,X
-    if (MyPE==0 && verbose>1) { cout<<ProgSign+"hdf5dims ="; for (int d = 0; d < (int)ndim; d++) cout<<" "<<hdf5dims[d]; cout<<endl; }
-    for (int dc = 0; dc < ncmp; dc++) { // loop over component(s)
-        string dsetname = "turb_field";
-        if (dc == 0) dsetname += "_x";
-        if (dc == 1) dsetname += "_y";
-        if (dc == 2) dsetname += "_z";
-        hdfio.create_dataset(dsetname, hdf5dims, H5T_NATIVE_FLOAT, MPI_COMM); // create HDF5 dataset
+    // filename of the piece written by core pe, and name of the dataset of component dc of core pe in it
+    auto piece_filename = [&](const Output & o, const int pe) {
+        stringstream ss; ss<<o.base<<"_"<<setfill('0')<<setw(5)<<pe<<".h5";
+        return ss.str();
+    };
+    auto piece_dsetname = [&](const int dc, const int pe) {
+        if (file_per == 1) return dsetnames[dc];
+        stringstream ss; ss<<dsetnames[dc]<<"_"<<pe;
+        return ss.str();
+    };
+    // dimensions (order Z,Y,X) of the piece of core pe, or of chunk ic of it (offset, count)
+    auto piece_dims = [&](const int pe, const int ic, hsize_t offset[], hsize_t count[]) {
+        const int * info = &piece_info[8*pe];
+        const int z0 = (ic < 0) ? 0 : min(ic*info[6], info[Z]);
+        for (int d = 0; d < (int)ndim; d++) {
+            int dd = (int)ndim-1-d; // order Z,Y,X
+            offset[dd] = (d==Z ? z0 : 0);
+            count[dd] = (d==Z && ic >= 0) ? min(info[6], info[Z]-z0) : info[d];
+        }
+    };
+    // create the HDF5 output file of a realisation, with the parameters and the (empty) datasets or pieces of the field
+    auto create_hdf5_output = [&](Output & o) {
+        HDFIO & hdfio = o.hdfio;
+        hdfio = HDFIO();
+        hdfio.setIOOptions(io_options);
+        hdfio.setHandleCache(true); // keep turb_field_* open while streaming chunks (slabs) in and out
+        if (out_writer) {
+            hdfio.create(o.filename, out_comm);
+            // write scalars (parameters), as one table of (name, value) per type ('integer scalars', 'real scalars'),
+            // each in a single collective write, rather than one tiny dataset per scalar
+            map<string, int> int_scalars;
+            map<string, double> real_scalars;
+            real_scalars["ndim"] = ndim;
+            int_scalars["ncmp"] = ncmp;
+            real_scalars["kmin"] = k_min;
+            real_scalars["kmid"] = k_mid;
+            real_scalars["kmax"] = k_max;
+            int_scalars["spect_form"] = spect_form;
+            if (spect_form == 2) {
+                real_scalars["power_law_exp"]   = power_law_exp;
+                real_scalars["power_law_exp_2"] = power_law_exp_2;
+                real_scalars["angles_exp"] = angles_exp;
+            }
+            real_scalars["sol_weight"] = sol_weight;
+            int_scalars["random_seed"] = o.seed;
+            hdfio.WriteFlashIntegerScalars(int_scalars, out_comm);
+            hdfio.WriteFlashRealScalars(real_scalars, out_comm);
+            // write N and L vectors
+            vector<hsize_t> vecdims(1, (int)ndim);
+            int No[(int)ndim]; double Lo[(int)ndim]; // order Z,Y,X
+            for (int d = 0; d < (int)ndim; d++) {
+                No[(int)ndim-1-d] = N[d];
+                Lo[(int)ndim-1-d] = L[d];
+            }
+            hdfio.write(No, "N", vecdims, H5T_NATIVE_INT, out_comm);
+            hdfio.write(Lo, "L", vecdims, H5T_NATIVE_DOUBLE, out_comm);
+        }
+        // create datasets for the turbulent field (components)
+        if (file_per == 0) {
+            for (int dc = 0; dc < ncmp; dc++)
+                hdfio.create_dataset(dsetnames[dc], hdf5dims, H5T_NATIVE_FLOAT, MPI_COMM, h5chunkdims, compress_level > 0, compress_level, scale_offset);
+            return;
+        }
+        if (MyPE==0 && verbose>0)
+            cout<<ProgSign+"Writing one file per "<<(file_per==1 ? "core" : "node")<<" ('"<<piece_filename(o, 0)<<"', ...), "
+                <<"stitched together by virtual datasets in '"<<o.filename<<"'."<<endl;
+        if (piece_info[8*MyPE+7] == MyPE) { // this core writes a piece file with the blocks of its node
+            o.hdfio_piece = HDFIO();
+            o.hdfio_piece.setIOOptions(io_options);
+            o.hdfio_piece.setHandleCache(true);
+            o.hdfio_piece.create(piece_filename(o, MyPE), MPI_COMM_NULL);
+            for (unsigned int i = 0; i < node_cores.size(); i++) {
+                hsize_t offset[(int)ndim], count[(int)ndim];
+                piece_dims(node_cores[i], -1, offset, count);
+                vector<hsize_t> piecedims(count, count+(int)ndim);
+                for (int dc = 0; dc < ncmp; dc++)
+                    o.hdfio_piece.create_dataset(piece_dsetname(dc, node_cores[i]), piecedims, H5T_NATIVE_FLOAT, MPI_COMM_NULL,
+                                                 h5chunkdims, compress_level > 0, compress_level, scale_offset);
+            }
+        }
+        if (out_writer) { // virtual datasets that map the pieces of all cores into the global field
+            for (int dc = 0; dc < ncmp; dc++) {
+                vector<NameSpaceHDFIO::VirtualSource> sources(NPE);
+                for (int pe = 0; pe < NPE; pe++) {
+                    string fname = piece_filename(o, piece_info[8*pe+7]);
+                    sources[pe].Filename = fname.substr(fname.find_last_of('/')+1); // relative to the output file
+                    sources[pe].Datasetname = piece_dsetname(dc, pe);
+                    sources[pe].Offset.resize((int)ndim); sources[pe].Count.resize((int)ndim);
+                    piece_dims(pe, -1, &sources[pe].Offset[0], &sources[pe].Count[0]);
+                    for (int d = 0; d < (int)ndim; d++) sources[pe].Offset[(int)ndim-1-d] = piece_info[8*pe+3+d];
+                }
+                hdfio.create_virtual_dataset(dsetnames[dc], hdf5dims, H5T_NATIVE_FLOAT, sources);
+            }
+        }
+    };
+    // read or write chunk ic of the piece of core pe (component dc) from/to the piece file, via the writer of its node
+    auto access_piece_chunk = [&](Output & o, const int ic, const int dc, const bool read, const int pe, float * grid) {
+        const int writer = piece_info[8*pe+7];
+        if ((MyPE != pe) && (MyPE != writer)) return;
+        hsize_t offset[(int)ndim], count[(int)ndim], out_offset[(int)ndim];
+        piece_dims(pe, ic, offset, count);
+        long nc = 1;
+        for (int d = 0; d < (int)ndim; d++) { nc *= count[d]; out_offset[d] = 0; }
+        if (nc == 0) return;
+        float * buf = grid;
+        vector<float> recv_buf;
+        if (MyPE != pe) { recv_buf.resize(nc); buf = &recv_buf[0]; } // writer, for another core of its node
+#ifdef HAVE_MPI
+        const long max_msg = 1L<<30; // elements per message (MPI counts are int)
+        if ((MyPE != writer) || (MyPE != pe)) { // send to / receive from the writer (or the other core)
+            const int partner = (MyPE == writer) ? pe : writer;
+            const bool send = (MyPE == pe) ? !read : read;
+            if (send && read && (MyPE == writer))
+                o.hdfio_piece.read_slab(buf, piece_dsetname(dc, pe), H5T_NATIVE_FLOAT, offset, count, (int)ndim, out_offset, count);
+            for (long i0 = 0; i0 < nc; i0 += max_msg) {
+                const int n = (int)min(max_msg, nc-i0);
+                if (send) MPI_Send(&buf[i0], n, MPI_FLOAT, partner, dc, MPI_COMM);
+                else MPI_Recv(&buf[i0], n, MPI_FLOAT, partner, dc, MPI_COMM, MPI_STATUS_IGNORE);
+            }
+            if (!send && !read && (MyPE == writer))
+                o.hdfio_piece.overwrite_slab(buf, piece_dsetname(dc, pe), H5T_NATIVE_FLOAT, offset, count, (int)ndim, out_offset, count);
+            return;
+        }
+#endif
+        if (read) o.hdfio_piece.read_slab(buf, piece_dsetname(dc, pe), H5T_NATIVE_FLOAT, offset, count, (int)ndim, out_offset, count);
+        else o.hdfio_piece.overwrite_slab(buf, piece_dsetname(dc, pe), H5T_NATIVE_FLOAT, offset, count, (int)ndim, out_offset, count);
+    };
+#endif
+    // create the output of the realisation with random seed 'seed' (in ensemble mode, one file per seed)
+    auto create_output = [&](Output & o, const int seed) {
+        o.seed = seed;
+        o.base = out_base;
+        o.filename = outfilename;
+        if (ensemble) {
+            stringstream ss; ss<<out_base<<"_seed"<<seed;
+            o.base = ss.str();
+            o.filename = o.base+".h5";
+        }
+        for (int dc = 0; dc < 3; dc++) { o.rawfilenames[dc] = o.base+"_"+dsetnames[dc]+".raw"; o.raw_fd[dc] = -1; }
+        if (MyPE==0 && verbose>0) {
+            cout<<"-----------------------------------------------------"<<endl;
+            if (raw_output) cout<<ProgSign+"Creating '"<<o.rawfilenames[0]<<"', ... (raw float32, little endian) and '"<<o.base<<".json' for output..."<<endl;
+            else cout<<ProgSign+"Creating '"<<o.filename<<"' for output..."<<endl;
+        }
+        if (raw_output) create_raw_output(o);
+#ifdef HAVE_HDF5
+        else create_hdf5_output(o);
+#endif
+    };
+    // read or write chunk ic of component dc (in grid) from/to its slab in the file (in parallel, if we have MPI)
+    auto access_chunk = [&](Output & o, const int ic, const int dc, const bool read, float * grid) {
+        if (raw_output) { raw_access_chunk(o, ic, dc, read, grid); return; }
+#ifdef HAVE_HDF5
+        if (file_per > 0) { // pieces; the writer of each node handles the cores of its node in turn
+            const vector<int> & cores = (piece_info[8*MyPE+7] == MyPE) ? node_cores : vector<int>(1, MyPE);
+            for (unsigned int i = 0; i < cores.size(); i++) access_piece_chunk(o, ic, dc, read, cores[i], grid);
+            return;
+        }
         // specify dimensions and offset for slab operation
         hsize_t offset[(int)ndim], count[(int)ndim], out_offset[(int)ndim], out_count[(int)ndim];
+        const int z0 = min(ic*nz_chunk, N_out[Z]), nz = min(nz_chunk, N_out[Z]-z0);
         for (int d = 0; d < (int)ndim; d++) {
             int dd = (int)ndim-1-d; // order Z,Y,X
-            // collective HDF5 IO only works if inactive cores participate, but with counts=0 and offsets=0
-            offset[dd] = 0; count[dd] = 0; out_offset[dd] = 0; out_count[dd] = 0;
-            if (MyPE < NPE_in_use) {
-                if (d==0) offset[dd] = MyPE*divN_PE;
-                count[dd] = N_out[d];
-                out_offset[dd] = 0;
-                out_count[dd] = N_out[d];
-            }
+            offset[dd] = offset_out[d] + (d==Z ? z0 : 0);
+            count[dd] = (d==Z ? nz : N_out[d]);
+            out_offset[dd] = 0;
+            out_count[dd] = count[dd];
         }
         if (verbose>1) {
             for (int d = 0; d < (int)ndim; d++)
                 cout<<"MyPE, d, offset, count, out_offset, out_count = "<<
                         MyPE<<" "<<d<<" "<<offset[d]<<" "<<count[d]<<" "<<out_offset[d]<<" "<<out_count[d]<<endl;
         }
-        // write slab to file (in parallel, if we have MPI)
-        hdfio.overwrite_slab(grid_out[dc], dsetname, H5T_NATIVE_FLOAT, offset, count, (int)ndim, out_offset, out_count, MPI_COMM);
-        if (MyPE==0 && verbose>0) cout<<ProgSign+"Dataset '"<<dsetname<<"' in '"<<outfilename<<"' written."<<endl;
-    }
-    // output generating modes and their amplitudes
-    if (write_modes) {
-        // modes
-        vector< vector<double> > modes = tg.get_modes();
-        int nmodes = modes[0].size(); // all dims have the same number of modes
-        hdf5dims.resize(2); hdf5dims[0] = (int)ndim; hdf5dims[1] = nmodes;
-        double * ptmp = new double[((int)ndim)*nmodes];
-        for (int d = 0; d < (int)ndim; d++)
-            for (int m = 0; m < nmodes; m++)
-                ptmp[d*nmodes+m] = modes[d][m];
-        hdfio.write(ptmp, "Fourier_modes", hdf5dims, H5T_NATIVE_DOUBLE, MPI_COMM);
-        delete [] ptmp;
-        // amplitudes
-        vector<double> amplitudes = tg.get_amplitudes();
-        ptmp = new double[amplitudes.size()];
-        for (int i = 0; i < amplitudes.size(); i++) ptmp[i] = amplitudes[i];
-        hdf5dims.resize(1); hdf5dims[0] = amplitudes.size();
-        hdfio.write(ptmp, "Fourier_amplitudes", hdf5dims, H5T_NATIVE_DOUBLE, MPI_COMM);
-        delete [] ptmp;
-    }
-    hdfio.close();
-    if (MyPE==0 && verbose>0) cout<<ProgSign+"Finished writing '"<<outfilename<<"'."<<endl;
+        if (read) o.hdfio.read_slab(grid, dsetnames[dc], H5T_NATIVE_FLOAT, offset, count, (int)ndim, out_offset, out_count, MPI_COMM);
+        else o.hdfio.overwrite_slab(grid, dsetnames[dc], H5T_NATIVE_FLOAT, offset, count, (int)ndim, out_offset, out_count, MPI_COMM);
+#endif
+    };
+    // read or write chunk ic of the nr realisations of the current batch from/to the grids of buffer b
+    int nr = 1; // number of realisations in the current batch
+    auto read_chunk  = [&](const int ic, const int b) { for (int r = 0; r < nr; r++) for (int dc = 0; dc < ncmp; dc++) access_chunk(out[r], ic, dc, true,  grids(b, r)[dc]); };
+    auto write_chunk = [&](const int ic, const int b) { for (int r = 0; r < nr; r++) for (int dc = 0; dc < ncmp; dc++) access_chunk(out[r], ic, dc, false, grids(b, r)[dc]); };
+    // run an I/O task in the I/O thread, once the previous one has finished (pipelining), or right here
+#ifdef HAVE_THREADS
+    std::thread io_thread;
+    auto io_join = [&]() { if (io_thread.joinable()) io_thread.join(); };
+    auto io_launch = [&](const function<void()> & task) { io_join(); if (pipelined) io_thread = std::thread(task); else task(); };
+#else
+    auto io_join = [&]() {};
+    auto io_launch = [&](const function<void()> & task) { task(); };
+#endif
+    // write the modes, parameters (raw output: JSON sidecar) and close the output of a realisation
+    auto finish_output = [&](Output & o) {
+        if (raw_output) {
+            for (int dc = 0; dc < ncmp; dc++) close(o.raw_fd[dc]);
+            // output generating modes and their amplitudes (raw float64)
+            vector<string> modefilenames;
+            if (write_modes && (MyPE == 0)) {
+                vector< vector<double> > modes = tg.get_modes();
+                vector<double> amplitudes = tg.get_amplitudes();
+                modefilenames.push_back(o.base+"_Fourier_modes.raw");
+                modefilenames.push_back(o.base+"_Fourier_amplitudes.raw");
+                for (int i = 0; i < 2; i++) {
+                    vector<double> buf;
+                    if (i == 0) for (int d = 0; d < (int)ndim; d++) buf.insert(buf.end(), modes[d].begin(), modes[d].end());
+                    else buf = amplitudes;
+                    if (!little_endian) for (unsigned long j = 0; j < buf.size(); j++)
+                        std::reverse((char *)&buf[j], (char *)&buf[j]+sizeof(double));
+                    FILE * fp = fopen(modefilenames[i].c_str(), "wb");
+                    if (!fp || (fwrite(&buf[0], sizeof(double), buf.size(), fp) != buf.size())) {
+                        cout<<ProgSign+"ERROR: cannot write '"<<modefilenames[i]<<"'."<<endl;
+                        exit(-1);
+                    }
+                    fclose(fp);
+                }
+            }
+            // JSON sidecar with the layout of the raw files, and N, L and the parameters of the field
+            if (MyPE == 0) {
+                string jsonfilename = o.base+".json";
+                ofstream json(jsonfilename.c_str());
+                json<<setprecision(17);
+                json<<"{"<<endl;
+                json<<"  \"format\": \"TurbGen raw\","<<endl;
+                json<<"  \"dtype\": \"<f4\","<<endl;
+                json<<"  \"order\": \"C\","<<endl;
+                json<<"  \"shape\": ["; for (int d = (int)ndim-1; d >= 0; d--) json<<N[d]<<(d>0 ? ", " : ""); json<<"],"<<endl;
+                json<<"  \"files\": {"<<endl;
+                for (int dc = 0; dc < ncmp; dc++) {
+                    string fname = o.rawfilenames[dc].substr(o.rawfilenames[dc].find_last_of('/')+1); // relative to the sidecar
+                    json<<"    \""<<dsetnames[dc]<<"\": \""<<fname<<"\""<<(dc<ncmp-1 ? "," : "")<<endl;
+                }
+                json<<"  },"<<endl;
+                if (modefilenames.size() > 0) {
+                    json<<"  \"Fourier_modes\": {\"file\": \""<<modefilenames[0].substr(modefilenames[0].find_last_of('/')+1)
+                        <<"\", \"dtype\": \"<f8\", \"shape\": ["<<(int)ndim<<", "<<tg.get_modes()[0].size()<<"]},"<<endl;
+                    json<<"  \"Fourier_amplitudes\": {\"file\": \""<<modefilenames[1].substr(modefilenames[1].find_last_of('/')+1)
+                        <<"\", \"dtype\": \"<f8\", \"shape\": ["<<tg.get_amplitudes().size()<<"]},"<<endl;
+                }
+                json<<"  \"ndim\": "<<ndim<<","<<endl;
+                json<<"  \"ncmp\": "<<ncmp<<","<<endl;
+                json<<"  \"N\": ["; for (int d = (int)ndim-1; d >= 0; d--) json<<N[d]<<(d>0 ? ", " : ""); json<<"],"<<endl; // order Z,Y,X
+                json<<"  \"L\": ["; for (int d = (int)ndim-1; d >= 0; d--) json<<L[d]<<(d>0 ? ", " : ""); json<<"],"<<endl; // order Z,Y,X
+                json<<"  \"kmin\": "<<k_min<<","<<endl;
+                json<<"  \"kmid\": "<<k_mid<<","<<endl;
+                json<<"  \"kmax\": "<<k_max<<","<<endl;
+                json<<"  \"spect_form\": "<<spect_form<<","<<endl;
+                if (spect_form == 2) {
+                    json<<"  \"power_law_exp\": "<<power_law_exp<<","<<endl;
+                    json<<"  \"power_law_exp_2\": "<<power_law_exp_2<<","<<endl;
+                    json<<"  \"angles_exp\": "<<angles_exp<<","<<endl;
+                }
+                json<<"  \"sol_weight\": "<<sol_weight<<","<<endl;
+                json<<"  \"random_seed\": "<<o.seed<<endl;
+                json<<"}"<<endl;
+                json.close();
+                if (verbose>0) cout<<ProgSign+"Finished writing '"<<o.rawfilenames[0]<<"', ... and '"<<jsonfilename<<"'."<<endl;
+            }
+        }
+#ifdef HAVE_HDF5
+        else {
+            HDFIO & hdfio = o.hdfio;
+            if (MyPE==0 && verbose>0) for (int dc = 0; dc < ncmp; dc++)
+                cout<<ProgSign+"Dataset '"<<dsetnames[dc]<<"' in '"<<o.filename<<"' written."<<endl;
+            // output generating modes and their amplitudes
+            if (write_modes && out_writer) {
+                vector<hsize_t> hdf5dims(2);
+                // modes
+                vector< vector<double> > modes = tg.get_modes();
+                int nmodes = modes[0].size(); // all dims have the same number of modes
+                hdf5dims[0] = (int)ndim; hdf5dims[1] = nmodes;
+                double * ptmp = new double[((int)ndim)*nmodes];
+                for (int d = 0; d < (int)ndim; d++)
+                    for (int m = 0; m < nmodes; m++)
+                        ptmp[d*nmodes+m] = modes[d][m];
+                hdfio.write(ptmp, "Fourier_modes", hdf5dims, H5T_NATIVE_DOUBLE, out_comm);
+                delete [] ptmp;
+                // amplitudes
+                vector<double> amplitudes = tg.get_amplitudes();
+                ptmp = new double[amplitudes.size()];
+                for (int i = 0; i < amplitudes.size(); i++) ptmp[i] = amplitudes[i];
+                hdf5dims.resize(1); hdf5dims[0] = amplitudes.size();
+                hdfio.write(ptmp, "Fourier_amplitudes", hdf5dims, H5T_NATIVE_DOUBLE, out_comm);
+                delete [] ptmp;
+            }
+            if (out_writer) hdfio.close();
+            if ((file_per > 0) && (piece_info[8*MyPE+7] == MyPE)) o.hdfio_piece.close();
+            if (MyPE==0 && verbose>0) cout<<ProgSign+"Finished writing '"<<o.filename<<"'."<<endl;
+        }
 #endif
+    };
+
+    // patterns (coefficients) of the realisations of the current batch, if they share the modes (ensemble mode)
+    vector<TurbGen::SnapshotHandle> snaps;
+    // with -interpolate: upper bound of the interpolation error over the chunks (absolute, before the normalisation)
+    double interpolation_error = 0.0;
+
+    // generate chunk ic, i.e., cells [ic*nz_chunk, (ic+1)*nz_chunk) in z of the local block, of the realisations of
+    // the current batch into the grids of buffer b; returns the number of cells
+    auto generate_chunk = [&](const int ic, const int b) {
+        const int z0 = min(ic*nz_chunk, N_out[Z]);
+        int n[3] = {N_out[X], N_out[Y], min(nz_chunk, N_out[Z]-z0)};
+        const long nc = (long)n[X]*n[Y]*n[Z];
+        if (nc == 0) return nc;
+        float ** grid = grids(b, 0);
+        // call to return uniform grid(s) with ncmp components of the turbulent field at requested positions
+        if (interpolation_tolerance > 0.0) {
+            double pos_beg_chunk[3] = {pos_beg[X], pos_beg[Y], pos_beg[Z]}, pos_end_chunk[3] = {pos_end[X], pos_end[Y], pos_end[Z]};
+            if (nchunks > 1) {
+                pos_beg_chunk[Z] = L[Z] * (double)(offset_out[Z]+z0) / (double)N[Z] + del[Z]/2.0;
+                pos_end_chunk[Z] = L[Z] * (double)(offset_out[Z]+z0+n[Z]) / (double)N[Z] - del[Z]/2.0;
+            }
+            double error_bound = 0.0; // upper bound of the interpolation error (absolute, before the normalisation below)
+            tg.get_turb_vector_unigrid_interpolated(pos_beg_chunk, pos_end_chunk, n, grid, interpolation_tolerance, error_bound);
+            interpolation_error = max(interpolation_error, error_bound);
+        } else {
+            // sub-extent of the global grid (64-bit extents), bit-identical for any decomposition and chunking
+            const long chunk_beg[3] = {offset_out[X], offset_out[Y], (long)offset_out[Z]+z0};
+            if (snaps.empty()) tg.get_turb_vector_unigrid_chunk(pos_beg_global, pos_end_global, N_global, chunk_beg, n, grid);
+            else { // all realisations of the batch in one pass over the mode tables
+                vector<float **> batch_grids(nr);
+                for (int r = 0; r < nr; r++) batch_grids[r] = grids(b, r);
+                tg.get_turb_vector_unigrid_chunk(snaps, pos_beg_global, pos_end_global, N_global, chunk_beg, n, &batch_grids[0]);
+            }
+        }
+        return nc;
+    };
+
+    for (unsigned int i0 = 0; i0 < my_seeds.size(); i0 += nbatch) {
+        // realisations of this batch
+        nr = min(nbatch, (int)my_seeds.size()-(int)i0);
+        snaps.clear();
+        if (shared_modes) for (int r = 0; r < nr; r++) snaps.push_back(tg.get_snapshot(my_seeds[i0+r]));
+        else if (i0 > 0) // re-initialise the generator for the next seed
+            tg.init_single_realisation(ndim, L, k_min, k_mid, k_max, spect_form, power_law_exp, power_law_exp_2, angles_exp, sol_weight, my_seeds[i0]);
+        for (int r = 0; r < nr; r++) create_output(out[r], my_seeds[i0+r]);
+        interpolation_error = 0.0;
+
+        // compute mean and std of generated turbulent field and then re-normalise to mean=0 and std=1
+        vector<double> mean (3*nbatch, 0.0); // for realisation r and component d: [3*r+d]
+        vector<double> mean2(3*nbatch, 0.0);
+        vector<double> std(3*nbatch, 0.0);
+        for (int ic = 0; ic < nchunks; ic++) {
+            const int b = ic % nbuf;
+            long nc = generate_chunk(ic, b);
+            for (int r = 0; r < nr; r++) for (int d = 0; d < ncmp; d++) {
+                const float * grid = grids(b, r)[d];
+                for (long ni = 0; ni < nc; ni++) {
+                    mean [3*r+d] += grid[ni];
+                    mean2[3*r+d] += pow(grid[ni],2.0);
+                }
+            }
+            if (nchunks > 1) io_launch([&, ic, b]() { write_chunk(ic, b); }); // un-normalised field (see below)
+        }
+        io_join();
+#ifdef HAVE_MPI
+        MPI_Allreduce(MPI_IN_PLACE, &mean [0], 3*nbatch, MPI_DOUBLE, MPI_SUM, MPI_COMM);
+        MPI_Allreduce(MPI_IN_PLACE, &mean2[0], 3*nbatch, MPI_DOUBLE, MPI_SUM, MPI_COMM);
+#endif
+        const double ncells_global = (double)N_global[X] * N_global[Y] * N_global[Z]; // total number of cells (> 2^31 for > 1290^3)
+        for (int i = 0; i < 3*nr; i++) {
+            mean [i] /= ncells_global; // mean
+            mean2[i] /= ncells_global; // mean squared
+            std[i] = sqrt(mean2[i] - mean[i]*mean[i]); // standard deviation
+        }
+        if (interpolation_tolerance > 0.0) { // report the interpolation error once (not per chunk); one realisation per batch
+#ifdef HAVE_MPI
+            MPI_Allreduce(MPI_IN_PLACE, &interpolation_error, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM);
+#endif
+            double rel_error = 0.0; // relative to the standard deviation, i.e., after the normalisation below
+            for (int d = 0; d < ncmp; d++) if (std[d] > 0.0) rel_error = max(rel_error, interpolation_error / std[d]);
+            if (MyPE==0 && verbose>0) cout<<ProgSign+"Interpolated from a coarser grid; interpolation error bound = "<<rel_error<<" of the standard deviation"<<endl;
+        }
+
+        // re-normalise (when streaming, in a second pass over the chunks in the file) and re-compute mean and std
+        vector<double> mean_new(3*nbatch, 0.0), mean2_new(3*nbatch, 0.0);
+        for (int ic = 0; ic < nchunks; ic++) {
+            const int z0 = min(ic*nz_chunk, N_out[Z]);
+            const long nc = (long)N_out[X]*N_out[Y]*min(nz_chunk, N_out[Z]-z0);
+            const int b = ic % nbuf;
+            if (nchunks > 1) {
+                if (pipelined) {
+                    // the I/O thread writes chunk ic-1 and then reads chunk ic+1 into the other grids, while chunk ic is normalised
+                    if (ic == 0) io_launch([&]() { read_chunk(0, 0); });
+                    io_join();
+                    const int other = (ic+1) % nbuf;
+                    io_launch([&, ic, other]() { if (ic > 0) write_chunk(ic-1, other); if (ic+1 < nchunks) read_chunk(ic+1, other); });
+                }
+                else read_chunk(ic, b);
+            }
+            for (int r = 0; r < nr; r++) for (int d = 0; d < ncmp; d++) {
+                float * grid = grids(b, r)[d];
+                for (long ni = 0; ni < nc; ni++) {
+                    grid[ni] -= mean[3*r+d];
+                    grid[ni] /= std[3*r+d];
+                    mean_new [3*r+d] += grid[ni];
+                    mean2_new[3*r+d] += pow(grid[ni],2.0);
+                }
+            }
+            if (!pipelined) write_chunk(ic, b); // write slab to file
+            else if (ic == nchunks-1) { io_launch([&, ic, b]() { write_chunk(ic, b); }); io_join(); }
+        }
+#ifdef HAVE_MPI
+        MPI_Allreduce(MPI_IN_PLACE, &mean_new [0], 3*nbatch, MPI_DOUBLE, MPI_SUM, MPI_COMM);
+        MPI_Allreduce(MPI_IN_PLACE, &mean2_new[0], 3*nbatch, MPI_DOUBLE, MPI_SUM, MPI_COMM);
+#endif
+        for (int i = 0; i < 3*nr; i++) {
+            mean [i] = mean_new [i] / ncells_global; // mean
+            mean2[i] = mean2_new[i] / ncells_global; // mean squared
+            std[i] = sqrt(mean2[i] - mean[i]*mean[i]); // standard deviation
+        }
+
+        for (int r = 0; r < nr; r++) {
+            if (MyPE==0 && verbose>0) {
+                const double * m = &mean[3*r], * s = &std[3*r];
+                cout<<ProgSign+"Generated "<<ndim<<"D turbulent field"<<(ensemble ? " (random seed "+to_string(out[r].seed)+")" : "")<<" with"<<endl;
+                cout<<ProgSign+" number of grid cells N ="; for (int d = 0; d < (int)ndim; d++) cout<<" "<<N[d]; cout<<endl;
+                cout<<ProgSign+" physical size L ="; for (int d = 0; d < (int)ndim; d++) cout<<" "<<L[d]; cout<<endl;
+                cout<<ProgSign+" mean (for each component) ="; for (int d = 0; d < ncmp; d++) cout<<" "<<m[d]; cout<<endl;
+                cout<<ProgSign+" 1D standard deviation (for each component) ="; for (int d = 0; d < ncmp; d++) cout<<" "<<s[d]; cout<<endl;
+                string expected = "";
+                if (ncmp==1) expected = "1";
+                if (ncmp==2) expected = "sqrt(2)";
+                if (ncmp==3) expected = "sqrt(3)";
+                cout<<ProgSign+" total ("<<ndim<<"D) standard deviation (expected: "<<expected<<") = "<<sqrt(s[0]*s[0]+s[1]*s[1]+s[2]*s[2])<<endl;
+            }
+            finish_output(out[r]);
+        }
+    }
 
     // clean up
-    for (int d = 0; d < ncmp; d++) {
-      if (grid_out[d]) delete [] grid_out[d]; grid_out[d] = NULL;
+    for (unsigned int i = 0; i < grid_out.size(); i++) {
+        if (grid_out[i]) delete [] grid_out[i];
+        grid_out[i] = NULL;
     }
 
     /// print out wallclock time used
@@ -325,6 +885,7 @@ int main(int argc, char * argv[])
     }
 
 #ifdef HAVE_MPI
+    if (group_comm != MPI_COMM_WORLD) MPI_Comm_free(&group_comm);
     MPI_Finalize();
 #endif
     return 0;
@@ -372,6 +933,88 @@ int ParseInputs(const vector<string> Argument)
                 if ((int)ndim > 2) { dummystream << Argument[i+3]; dummystream >> N[Z]; dummystream.clear(); }
             } else return -1;
         }
+        if (Argument[i] != "" && Argument[i] == "-h5_chunks")
+        {
+            h5_chunks = true;
+        }
+        if (Argument[i] != "" && Argument[i] == "-compress")
+        {
+            if (Argument.size()>i+1) {
+                dummystream << Argument[i+1]; dummystream >> compress_level; dummystream.clear();
+            } else return -1;
+        }
+        if (Argument[i] != "" && Argument[i] == "-scale_offset")
+        {
+            if (Argument.size()>i+1) {
+                dummystream << Argument[i+1]; dummystream >> scale_offset; dummystream.clear();
+            } else return -1;
+        }
+        if (Argument[i] != "" && Argument[i] == "-raw")
+        {
+            raw_output = true;
+        }
+        if (Argument[i] != "" && Argument[i] == "-file_per")
+        {
+            if (Argument.size()>i+1) {
+                if (Argument[i+1] == "rank") file_per = 1;
+                else if (Argument[i+1] == "node") file_per = 2;
+                else return -1;
+            } else return -1;
+        }
+        if (Argument[i] != "" && Argument[i] == "-io_align")
+        {
+            if (Argument.size()>i+1) {
+                dummystream << Argument[i+1]; dummystream >> io_alignment; dummystream.clear();
+            } else return -1;
+        }
+        if (Argument[i] != "" && Argument[i] == "-io_mdc_size")
+        {
+            if (Argument.size()>i+1) {
+                dummystream << Argument[i+1]; dummystream >> io_mdc_size; dummystream.clear();
+            } else return -1;
+        }
+        if (Argument[i] != "" && Argument[i] == "-io_coll_metadata")
+        {
+            io_coll_metadata = true;
+        }
+        if (Argument[i] != "" && Argument[i] == "-io_cb_nodes")
+        {
+            if (Argument.size()>i+1) {
+                dummystream << Argument[i+1]; dummystream >> io_cb_nodes; dummystream.clear();
+            } else return -1;
+        }
+        if (Argument[i] != "" && Argument[i] == "-io_cb_buffer_size")
+        {
+            if (Argument.size()>i+1) {
+                dummystream << Argument[i+1]; dummystream >> io_cb_buffer_size; dummystream.clear();
+            } else return -1;
+        }
+        if (Argument[i] != "" && Argument[i] == "-io_striping")
+        {
+            if (Argument.size()>i+2) {
+                dummystream << Argument[i+1]; dummystream >> io_striping_factor; dummystream.clear();
+                dummystream << Argument[i+2]; dummystream >> io_striping_unit; dummystream.clear();
+            } else return -1;
+        }
+        if (Argument[i] != "" && Argument[i] == "-pipeline")
+        {
+            pipeline = true;
+        }
+        if (Argument[i] != "" && Argument[i] == "-chunk_nz")
+        {
+            if (Argument.size()>i+1) {
+                dummystream << Argument[i+1]; dummystream >> chunk_nz; dummystream.clear();
+            } else return -1;
+        }
+        if (Argument[i] != "" && Argument[i] == "-decomp")
+        {
+            if (Argument.size()>i+(int)ndim) {
+                dummystream << Argument[i+1]; dummystream >> decomp[X]; dummystream.clear();
+                if ((int)ndim > 1) { dummystream << Argument[i+2]; dummystream >> decomp[Y]; dummystream.clear(); }
+                if ((int)ndim > 2) { dummystream << Argument[i+3]; dummystream >> decomp[Z]; dummystream.clear(); }
+                decomp_set = true;
+            } else return -1;
+        }
         if (Argument[i] != "" && Argument[i] == "-L")
         {
             if (Argument.size()>i+(int)ndim) {
@@ -434,6 +1077,35 @@ int ParseInputs(const vector<string> Argument)
                 dummystream << Argument[i+1]; dummystream >> random_seed; dummystream.clear();
             } else return -1;
         }
+        if (Argument[i] != "" && Argument[i] == "-seeds")
+        {
+            if (Argument.size()>i+1) {
+                string range = Argument[i+1]; // a:b
+                size_t colon = range.find(':');
+                if (colon == string::npos) return -1;
+                dummystream << range.substr(0, colon); dummystream >> seed_first; dummystream.clear();
+                dummystream << range.substr(colon+1); dummystream >> seed_last; dummystream.clear();
+                if (seed_last < seed_first) return -1;
+            } else return -1;
+        }
+        if (Argument[i] != "" && Argument[i] == "-nrealisations")
+        {
+            if (Argument.size()>i+1) {
+                dummystream << Argument[i+1]; dummystream >> nrealisations; dummystream.clear();
+            } else return -1;
+        }
+        if (Argument[i] != "" && Argument[i] == "-ensemble_batch")
+        {
+            if (Argument.size()>i+1) {
+                dummystream << Argument[i+1]; dummystream >> ensemble_batch; dummystream.clear();
+            } else return -1;
+        }
+        if (Argument[i] != "" && Argument[i] == "-ensemble_groups")
+        {
+            if (Argument.size()>i+1) {
+                dummystream << Argument[i+1]; dummystream >> ensemble_groups; dummystream.clear();
+            } else return -1;
+        }
         if (Argument[i] != "" && Argument[i] == "-o")
         {
             if (Argument.size()>i+1) {
@@ -444,6 +1116,44 @@ int ParseInputs(const vector<string> Argument)
         {
             write_modes = true;
         }
+        if (Argument[i] != "" && Argument[i] == "-angles_sampling")
+        {
+            if (Argument.size()>i+1) {
+                dummystream << Argument[i+1]; dummystream >> angles_sampling; dummystream.clear();
+            } else return -1;
+        }
+        if (Argument[i] != "" && Argument[i] == "-max_nmodes")
+        {
+            if (Argument.size()>i+1) {
+                dummystream << Argument[i+1]; dummystream >> max_nmodes; dummystream.clear();
+            } else return -1;
+        }
+        if (Argument[i] != "" && Argument[i] == "-eval_time")
+        {
+            if (Argument.size()>i+1) {
+                dummystream << Argument[i+1]; dummystream >> eval_time; dummystream.clear();
+            } else return -1;
+        }
+        if (Argument[i] != "" && Argument[i] == "-mpi_shared_modes")
+        {
+            mpi_shared_modes = true;
+        }
+        if (Argument[i] != "" && Argument[i] == "-merge_modes")
+        {
+            merge_modes = true;
+        }
+        if (Argument[i] != "" && Argument[i] == "-interpolate")
+        {
+            if (Argument.size()>i+1) {
+                dummystream << Argument[i+1]; dummystream >> interpolation_tolerance; dummystream.clear();
+            } else return -1;
+        }
+        if (Argument[i] != "" && Argument[i] == "-truncate_modes")
+        {
+            if (Argument.size()>i+1) {
+                dummystream << Argument[i+1]; dummystream >> truncation_taper; dummystream.clear();
+            } else return -1;
+        }
     } // loop over all args
 
     /// print out parsed values
@@ -480,9 +1190,34 @@ void HelpMe(void)
         << "     -angles_exp <val>         : if spect_form 2: angles exponent for sparse sampling (e.g., 2.0: full sampling, 0.0: healpix-like sampling); (default: 1.0)" << endl
         << "     -sol_weight <val>         : solenoidal weight: 1.0 (divergence-free field), 0.5 (natural mix), 0.0 (curl-free field); (default: 0.5)" << endl
         << "     -random_seed <val>        : random seed for turbulent field; (default: 140281)" << endl
+        << "     -seeds <a:b>              : ensemble of realisations with random seeds a, a+1, ..., b, written into one file per seed (<outfile>_seed<s>.h5)" << endl
+        << "     -nrealisations <n>        : ensemble of n realisations with random seeds random_seed, ..., random_seed+n-1 (see -seeds)" << endl
+        << "     -ensemble_batch <n>       : ensemble with spect_form 0 or 1: number of realisations evaluated per pass over the mode tables; (default: 4)" << endl
+        << "     -ensemble_groups <n>      : ensemble with MPI: number of groups of cores, each generating a subset of the realisations; (default: min(NPE, number of seeds))" << endl
         << "     -verbose <0, 1, 2>        : 0 (no shell output), 1 (standard shell output), 2 (more shell output); (default: 1)" << endl
+        << "     -decomp <px [py [pz]]>    : number of cores along x, y, z for the domain decomposition (MPI); 0: automatic; (default: 0 1 1, i.e., slabs in x, or 0 0 0 if there are more cores than cells in x; 0 0 1: pencils; 0 0 0: blocks)" << endl
+        << "     -h5_chunks                : write turb_field_* with a chunked HDF5 layout (one chunk per core), for fast reads of subvolumes" << endl
+        << "     -compress <level>         : compress turb_field_* with shuffle + deflate (gzip) of level 1-9 (implies -h5_chunks)" << endl
+        << "     -scale_offset <digits>    : lossy scale-offset filter for turb_field_*, keeping <digits> decimal digits (implies -h5_chunks)" << endl
+        << "     -raw                      : write turb_field_* into raw binary files (little-endian float32, <outfile>_turb_field_x.raw, ...) with a JSON sidecar (<outfile>.json) for N, L and the parameters, instead of HDF5 (default without HDF5)" << endl
+        << "     -file_per <rank, node>    : write the field into one file per core (rank) or per node (written by its first core), stitched together by virtual datasets in the output file (HDF5 >= 1.10)" << endl
+        << "     -io_align <bytes>         : align turb_field_* in the HDF5 file to multiples of <bytes> (e.g., the stripe size of the parallel file system)" << endl
+        << "     -io_mdc_size <bytes>      : size of the HDF5 metadata cache" << endl
+        << "     -io_coll_metadata         : collective HDF5 metadata reads and writes (parallel HDF5 >= 1.10)" << endl
+        << "     -io_cb_nodes <n>          : MPI-IO hint: number of collective-buffering aggregators (cb_nodes)" << endl
+        << "     -io_cb_buffer_size <bytes>: MPI-IO hint: collective-buffering buffer size (cb_buffer_size)" << endl
+        << "     -io_striping <n> <bytes>  : MPI-IO hints: stripe count and stripe size of the output file (striping_factor, striping_unit; e.g., Lustre)" << endl
+        << "     -chunk_nz <nz>            : generate, normalise, and write the field in chunks of <nz> cells in z (out-of-core; bounds memory independent of N)" << endl
+        << "     -pipeline                 : with -chunk_nz: compute each chunk while the previous one is written (I/O thread, double buffering)" << endl
         << "     -o <filename>             : output filename (for HDF5 output); (default: TurbGen_output.h5)" << endl
         << "     -write_modes              : write generating Fourier modes and amplitudes to output file" << endl
+        << "     -angles_sampling <0, 1>   : if spect_form 2: sampling of angles: 0 (random), 1 (Fibonacci sphere, randomly rotated per k-shell; converges with fewer angles); (default: 0)" << endl
+        << "     -max_nmodes <n>           : if spect_form 2: maximum number of modes (fewer angles per k-shell, still ~ k^angles_exp)" << endl
+        << "     -eval_time <s>            : if spect_form 2: choose the number of modes such that the field evaluation takes about <s> seconds per core" << endl
+        << "     -mpi_shared_modes         : if MPI: store the mode table once per node (MPI-3 shared memory) instead of on each core" << endl
+        << "     -merge_modes              : if spect_form 2: merge sampled modes with the same wave vector (+/-k) into one mode of equal total power" << endl
+        << "     -interpolate <tol>        : evaluate on a coarser grid and interpolate (6th-order Lagrange), with interpolation error <= tol * rms; for band-limited fields (low kmax)" << endl
+        << "     -truncate_modes <taper>   : only evaluate modes with |k| <= pi/dx (resolved by the grid), with a cos^2 taper of relative width <taper> in [0, 1] below pi/dx" << endl
         << "     -h                        : print this help message" << endl
         << endl
         << "Example: TurbGen -ndim 2 -L 1.0 1.0"
@@ -31,6 +31,8 @@
 #include <sstream>
 #include <fstream>
 #include <vector>
+#include <map>
+#include <chrono>
 #include <algorithm>
 #include <string>
 #include <cstring>
@@ -39,6 +41,22 @@
 #include <cstdarg>
 #include <cfloat>
 #include <cmath>
+#include <memory>
+
+// normally set via compiler defines: #define HAVE_THREADS
+// (enables background precomputation of the next driving pattern, see set_async_update,
+//  and threaded evaluation of multiple blocks, see get_turb_vector_multiblock)
+#ifdef HAVE_THREADS
+#include <thread>
+#include <atomic>
+#endif
+
+// normally set via compiler defines: #define HAVE_MPI (or automatic, if mpi.h is included before this header)
+// (enables computing the modes on one rank and broadcasting them, see set_mpi_comm)
+#if defined(HAVE_MPI) || defined(MPI_VERSION)
+#include <mpi.h>
+#define TURBGEN_HAVE_MPI
+#endif
 
 namespace NameSpaceTurbGen {
     // constants
@@ -58,12 +76,36 @@ namespace NameSpaceTurbGen {
 
 class TurbGen
 {
+    public:
+        // mode geometry and amplitudes (including normalisation); constant after initialisation
+        struct ModeTable {
+            double ndim; // number of spatial dimensions
+            int ncmp; // number of components
+            int nmodes; // number of modes
+            const double * mode[3]; // modes
+            const double * ampl; // amplitudes including normalisation factors
+            std::vector<int> order; // index of each entry in the original mode list (empty: original order)
+            const double * kabs; // |k| of each entry, ascending (only with mode truncation, see set_mode_truncation; else NULL)
+            double taper; // relative width of the cos^2 taper below the cutoff wavenumber (0: sharp cutoff)
+            std::vector<double> data; // storage of mode, ampl, kabs (empty if in a node-shared window; see set_mpi_comm)
+        };
+        // immutable set of coefficients of one driving pattern (see get_snapshot)
+        struct Snapshot {
+            int step; // OU step number (epoch) of this pattern
+            std::shared_ptr<const ModeTable> table; // shared by all snapshots
+            std::vector<double> aka[3], akb[3]; // solenoidal and compressive decomposition coefficients
+            double ampl_factor[3]; // amplitude factors
+        };
+        typedef std::shared_ptr<const Snapshot> SnapshotHandle;
+
     private:
         enum {X, Y, Z};
         int verbose; // shell output level (0: no output, 1: standard output, 2: more output)
         std::string ClassSignature; // class signature
         std::string parameter_file; // parameter file for controlling turbulence driving
-        std::vector<double> mode[3], aka[3], akb[3], OUphases, ampl; // modes arrays, phases, amplitudes
+        std::vector<double> mode[3], OUphases, ampl; // modes arrays, phases, amplitudes
+        std::shared_ptr<const ModeTable> table; // modes and normalised amplitudes used for evaluation
+        SnapshotHandle snapshot; // current pattern; only accessed with std::atomic_load/store (see get_snapshot)
         int PE; // MPI task for printf purposes, if provided
         int nmodes; // number of modes
         double ndim; // number of spatial dimensions
@@ -86,6 +128,55 @@ class TurbGen
         double ampl_factor[3]; // scale amplitude by this factor (default: 1.0, 1.0, 1.0)
         int ampl_auto_adjust; // switch (0,1) to turn off/on automatic amplitude adjustment
         std::string evolfile;
+        int nthreads; // number of threads for get_turb_vector_multiblock
+        bool truncate_modes; // switch to evaluate only the modes resolved by the grid (see set_mode_truncation)
+        double truncation_taper; // relative width of the cos^2 taper below the cutoff wavenumber
+        bool merge_modes; // switch to merge duplicate lattice modes for spect_form = 2 (see set_merge_duplicate_modes)
+        int angles_sampling; // spect_form = 2: 0: random angles, 1: Fibonacci sphere with random rotation per shell
+        double shell_power_error[2]; // spect_form = 2: rms and max relative error of the power in the k-shells of the sampled modes
+        int budget_nmodes; // spect_form = 2: if > 0, maximum number of modes (see set_mode_budget)
+        double budget_time; // spect_form = 2: if > 0, target evaluation time (s) for a grid of budget_grid cells
+        int budget_grid[3]; // grid size for budget_time
+#ifdef TURBGEN_HAVE_MPI
+        MPI_Comm mpi_comm; // communicator of the ranks that initialise together (MPI_COMM_NULL: each rank on its own)
+        bool mpi_node_shared; // switch to place the mode table into an MPI-3 node-shared memory window
+        std::shared_ptr<MPI_Win> mpi_shared_win; // node-shared window holding the current mode table (if any)
+#endif
+
+        // sin(k_m x_i) and cos(k_m x_i) along one direction, for the grid positions x_i and modes m
+        struct TrigTable {
+            std::vector< std::vector<double> > sin, cos; // [i][m]
+        };
+        // uniform grid requested from get_turb_vector_unigrid, and its field for the precomputed OU step
+        struct AsyncGrid {
+            double pos_beg[3], pos_end[3];
+            int n[3], nguard[3];
+            std::vector<float> field[3]; // field without ampl_factor (applied when handed over)
+        };
+        // state of the background worker that precomputes the next OU step (see set_async_update)
+        struct AsyncState {
+            bool enabled; // switch to turn on background precomputation
+            bool precompute_grids; // switch to also precompute the fields of requested uniform grids
+            bool pending; // true, if the worker was launched and not yet handed over
+            int step; // OU step that the worker is computing
+            int seed; // random seed after the OU update of 'step'
+            std::vector<double> OUphases; // OU phases of 'step'
+            std::shared_ptr<Snapshot> snapshot; // pattern of 'step' (published on handover)
+            std::vector<AsyncGrid> grids; // grids computed by the worker for 'step'
+            std::vector<AsyncGrid> grids_current; // grids valid for the current step (handed over)
+            std::vector<AsyncGrid> grids_requested; // grids requested during the current step
+#ifdef HAVE_THREADS
+            std::thread worker;
+#endif
+            AsyncState(void) : enabled(false), precompute_grids(false), pending(false), step(-1), seed(0) {};
+            // copies only take over the settings; a running worker always stays with its original object
+            AsyncState(const AsyncState & other) :
+                enabled(other.enabled), precompute_grids(other.precompute_grids), pending(false), step(-1), seed(0) {};
+            AsyncState & operator=(const AsyncState & other) {
+                enabled = other.enabled; precompute_grids = other.precompute_grids;
+                return *this;
+            };
+        } async;
 
     /// Constructors
     public: TurbGen(void)
@@ -99,6 +190,7 @@ class TurbGen
     /// Destructor
     public: ~TurbGen()
     {
+      async_join(); // wait for background worker to finish (if any)
       if (verbose > 1) std::cout<<ClassSignature<<"destructor called."<<std::endl;
     };
     // General constructur
@@ -108,10 +200,25 @@ class TurbGen
         this->PE = PE;
         verbose = 1; // default verbose level
         evolfile = "TurbGen.dat";
+        step = -1; // internal OU step number
+        dt = 0.0; // only set for driving (see init_driving)
+        nthreads = 1; // serial evaluation of multiple blocks by default
+        truncate_modes = false; // evaluate all modes by default
+        truncation_taper = 0.0;
+        merge_modes = false; // keep all sampled modes by default
+        angles_sampling = 0; // random angles by default
+        shell_power_error[0] = 0.0; shell_power_error[1] = 0.0;
+        budget_nmodes = 0; // no mode budget by default
+        budget_time = 0.0;
+        budget_grid[X] = 1; budget_grid[Y] = 1; budget_grid[Z] = 1;
+#ifdef TURBGEN_HAVE_MPI
+        mpi_comm = MPI_COMM_NULL; // no collective initialisation by default
+        mpi_node_shared = false;
+#endif
     };
 
     // get function signature for printing to stdout
-    private: std::string FuncSig(const std::string func_name)
+    private: std::string FuncSig(const std::string func_name) const
     { return func_name+": "; };
 
     // ******************************************************
@@ -120,6 +227,162 @@ class TurbGen
     public: void set_verbose(const int verbose) {
         this->verbose = verbose;
     };
+    // ******************************************************
+    public: void set_async_update(const bool async_update) {
+        set_async_update(async_update, false);
+    };
+    // ******************************************************
+    public: void set_async_update(const bool async_update, const bool precompute_grids) {
+        // ******************************************************
+        // Switch on/off background precomputation of the next driving pattern (OU update and decomposition
+        // coefficients) while the caller (e.g., the hydro solver) is busy. check_for_update then simply hands
+        // over the precomputed pattern when the next step boundary is crossed. If 'precompute_grids' is set,
+        // the uniform grids requested with get_turb_vector_unigrid during one step are also evaluated in the
+        // background for the next step, and are returned from that cache if the same grid is requested again.
+        // Requires compilation with -DHAVE_THREADS; otherwise, patterns are always updated synchronously.
+        // ******************************************************
+        async_reset();
+#ifdef HAVE_THREADS
+        async.enabled = async_update;
+        async.precompute_grids = async_update && precompute_grids;
+#else
+        if (async_update) TurbGen_printf("WARNING: compiled without HAVE_THREADS; driving patterns are updated synchronously.\n");
+        (void)precompute_grids;
+        async.enabled = false;
+        async.precompute_grids = false;
+#endif
+        if (async.enabled && (step >= -1) && (dt > 0.0)) async_launch(); // start precomputing the next step
+    };
+    // ******************************************************
+    public: void set_nthreads(const int nthreads) {
+        // ******************************************************
+        // Set the number of threads used by get_turb_vector_multiblock (nthreads <= 0: all hardware threads).
+        // Requires compilation with -DHAVE_THREADS; otherwise, blocks are always evaluated serially.
+        // ******************************************************
+#ifdef HAVE_THREADS
+        this->nthreads = nthreads;
+        if (nthreads <= 0) this->nthreads = std::max(1, (int)std::thread::hardware_concurrency());
+#else
+        if (nthreads != 1) TurbGen_printf("WARNING: compiled without HAVE_THREADS; blocks are evaluated serially.\n");
+        this->nthreads = 1;
+#endif
+        if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"using %i thread(s).\n", this->nthreads);
+    };
+    // ******************************************************
+    public: void set_mode_truncation(const bool truncate_modes) {
+        set_mode_truncation(truncate_modes, 0.0);
+    };
+    // ******************************************************
+    public: void set_mode_truncation(const bool truncate_modes, const double taper) {
+        // ******************************************************
+        // Switch on/off resolution-aware mode truncation: the modes are sorted by |k| once, and the uniform-grid
+        // functions (get_turb_vector_unigrid*, get_turb_vector_multiblock) then only evaluate the modes with
+        // |k| <= pi/dx_max, where dx_max is the largest cell width of the grid (or block), i.e., the modes that
+        // are resolved, rather than aliased, by the grid. This saves most of the work on coarse AMR blocks when
+        // the spectrum extends to high k. If taper > 0, the amplitudes of the resolved modes are multiplied by
+        // cos^2(pi/2 * (|k|-k0)/(k_cut-k0)) for |k| > k0 = (1-taper)*k_cut (with k_cut = pi/dx_max), for a smooth cutoff.
+        // Point evaluations (get_turb_vector) always include all modes. Without truncation (default), the modes
+        // are evaluated in their original order, so the field is bit-identical to that of previous versions;
+        // with truncation, the sum over the modes is taken in a different order (equal to round-off), if all modes
+        // are resolved.
+        // ******************************************************
+        if ((taper < 0.0) || (taper > 1.0)) {
+            TurbGen_printf("ERROR: mode truncation taper must be in [0, 1].\n");
+            exit(-1);
+        }
+        this->truncate_modes = truncate_modes;
+        truncation_taper = taper;
+        if (table) { // already initialised: re-build the mode table and the current pattern in the new order
+            async_join();
+            init_mode_table();
+            get_decomposition_coeffs();
+            set_async_update(async.enabled, async.precompute_grids);
+        }
+    };
+    // ******************************************************
+    public: void set_merge_duplicate_modes(const bool merge_modes) {
+        // ******************************************************
+        // Switch on/off merging of duplicate modes for the power-law spectrum (spect_form = 2), where the randomly
+        // sampled angles are rounded to the k-space lattice, so many samples land on the same lattice vector.
+        // Samples with the same k (or -k, which gives the same real field statistics) are then merged into a
+        // single mode with amplitude sqrt(sum of amplitudes^2), i.e., with the same power, but with fewer modes
+        // to evaluate. Must be called before init_driving or init_single_realisation. Off by default, which
+        // keeps the random sequence and modes of previous versions.
+        // ******************************************************
+        if (table) TurbGen_printf("WARNING: set_merge_duplicate_modes only takes effect at the next initialisation.\n");
+        this->merge_modes = merge_modes;
+    };
+    // ******************************************************
+    public: void set_angles_sampling(const int angles_sampling) {
+        // ******************************************************
+        // Set the sampling of the wave-vector directions in each k-shell for the power-law spectrum (spect_form = 2).
+        // 0: independent random angles (default; previous versions).
+        // 1: stratified angles: a Fibonacci sphere (3D) or equally spaced angles (2D) of nang points per shell,
+        //    rotated by an independent random rotation in each shell, and evenly spaced radii within each shell.
+        //    The directions cover each shell evenly even for few angles (low angles_exp), and the amplitudes are
+        //    renormalised per k-shell to remove the power error from rounding to the k-space lattice
+        //    (see get_shell_power_error), so that the spectrum is accurate with a fraction of the modes.
+        // Must be called before init_driving or init_single_realisation.
+        // ******************************************************
+        if ((angles_sampling < 0) || (angles_sampling > 1)) {
+            TurbGen_printf("ERROR: angles_sampling must be 0 (random) or 1 (Fibonacci).\n");
+            exit(-1);
+        }
+        if (table) TurbGen_printf("WARNING: set_angles_sampling only takes effect at the next initialisation.\n");
+        this->angles_sampling = angles_sampling;
+    };
+    // ******************************************************
+    public: void set_mode_budget(const int max_nmodes) {
+        // ******************************************************
+        // Limit the number of modes of the power-law spectrum (spect_form = 2) to max_nmodes (0: no limit).
+        // If the sampling with angles_exp would exceed the budget, the number of angles in each k-shell is
+        // reduced, while staying proportional to k^angles_exp, and the amplitudes are normalised accordingly,
+        // so the spectrum is the same, but sampled with fewer modes. Must be called before init_driving or
+        // init_single_realisation.
+        // ******************************************************
+        if (table) TurbGen_printf("WARNING: set_mode_budget only takes effect at the next initialisation.\n");
+        budget_nmodes = std::max(max_nmodes, 0);
+        budget_time = 0.0;
+    };
+    // ******************************************************
+    public: void set_mode_budget(const double eval_time, const int n[]) {
+        // ******************************************************
+        // Same as set_mode_budget above, but with the budget given as a target time (in seconds) for the evaluation
+        // of the field on a uniform grid of n[X]*n[Y]*n[Z] cells with get_turb_vector_unigrid (single-threaded).
+        // The maximum number of modes is derived from a measurement of the evaluation cost per mode and cell on
+        // this machine (see get_estimated_evaluation_time).
+        // ******************************************************
+        if (table) TurbGen_printf("WARNING: set_mode_budget only takes effect at the next initialisation.\n");
+        budget_nmodes = 0;
+        budget_time = std::max(eval_time, 0.0);
+        for (int d = 0; d < 3; d++) budget_grid[d] = std::max(n[d], 1);
+    };
+#ifdef TURBGEN_HAVE_MPI
+    // ******************************************************
+    public: void set_mpi_comm(MPI_Comm comm) {
+        set_mpi_comm(comm, false);
+    };
+    // ******************************************************
+    public: void set_mpi_comm(MPI_Comm comm, const bool node_shared) {
+        // ******************************************************
+        // Initialise collectively on the ranks of 'comm': init_driving and init_single_realisation must then be
+        // called by all ranks of 'comm' (with the same parameters), and the modes are only generated on rank 0
+        // of 'comm' and broadcast to the other ranks (instead of every rank scanning k-space by itself).
+        // The result is identical to that of the independent initialisation on each rank.
+        // If node_shared (requires MPI-3), the read-only mode table used for the evaluation (modes, amplitudes)
+        // is placed into a node-shared memory window, i.e., stored only once per node. The window is
+        // freed when the object is re-initialised or destroyed, which must also happen on all ranks of the node;
+        // snapshots (see get_snapshot) must not be used after that.
+        // Must be called before init_driving or init_single_realisation.
+        // ******************************************************
+        mpi_comm = comm;
+        mpi_node_shared = node_shared;
+#if MPI_VERSION < 3
+        if (node_shared) TurbGen_printf("WARNING: node-shared mode table requires MPI-3; using a copy on each rank.\n");
+        mpi_node_shared = false;
+#endif
+    };
+#endif
     // ******************************************************
     // get functions
     // ******************************************************
@@ -130,6 +393,52 @@ class TurbGen
         return nsteps_per_t_turb;
     };
     // ******************************************************
+    public: double get_shell_power_error(void) {
+        // ******************************************************
+        // Return the rms (over the k-shells) relative error of the power of the sampled modes in each k-shell,
+        // with respect to the target spectrum (spect_form = 2 only, excluding the partially filled first and
+        // last shell; 0 otherwise). This measures the fidelity of the angles sampling (see set_angles_sampling),
+        // so for stratified sampling it is the error before the per-shell renormalisation, which removes it.
+        // ******************************************************
+        return shell_power_error[0];
+    };
+    // ******************************************************
+    public: void get_shell_power_error(double & rms, double & max) {
+        // ******************************************************
+        // Same as above, but return both the rms and the maximum (over the k-shells) relative error.
+        // ******************************************************
+        rms = shell_power_error[0];
+        max = shell_power_error[1];
+    };
+    // ******************************************************
+    public: double next_update_time(void) const {
+        // ******************************************************
+        // Return the time at which check_for_update will generate the next driving pattern.
+        // ******************************************************
+        if (dt <= 0.0) return DBL_MAX; // not driving (see init_driving)
+        return (step+1) * dt;
+    };
+    // ******************************************************
+    public: bool will_update(const double time) const {
+        // ******************************************************
+        // Return whether check_for_update(time) would generate a new driving pattern. This is cheap and does not
+        // change any state, so callers can skip work that is only needed for an update (e.g., computing v_turb).
+        // ******************************************************
+        if (dt <= 0.0) return false; // not driving (see init_driving)
+        int step_requested = floor(time / dt); // same as in check_for_update
+        return (step_requested > step);
+    };
+    // ******************************************************
+    public: double get_estimated_evaluation_time(const int n[]) {
+        // ******************************************************
+        // Return an estimate of the time (in seconds) to evaluate the field on a uniform grid of n[X]*n[Y]*n[Z] cells
+        // with get_turb_vector_unigrid (single-threaded), based on the current number of modes and the evaluation
+        // cost per mode and cell measured on this machine (once per program; see get_evaluation_cost).
+        // ******************************************************
+        const double ncells = (double)std::max(n[X],1) * std::max(n[Y],1) * std::max(n[Z],1);
+        return get_evaluation_cost() * nmodes * ncells;
+    };
+    // ******************************************************
     public: int get_number_of_components(void) {
         return ncmp;
     };
@@ -145,6 +454,37 @@ class TurbGen
         return ampl;
     };
     // ******************************************************
+    public: SnapshotHandle get_snapshot(void) const {
+        // ******************************************************
+        // Return a handle to the current (immutable) driving pattern. The handle keeps the pattern alive,
+        // even if check_for_update publishes a new pattern in the meantime, so any number of threads can
+        // evaluate it with the const get_turb_vector[_unigrid](snapshot, ...) methods without locking.
+        // ******************************************************
+        return std::atomic_load(&snapshot);
+    };
+    // ******************************************************
+    public: SnapshotHandle get_snapshot(const int random_seed) const {
+        // ******************************************************
+        // Return the pattern of the single realisation with random seed 'random_seed' (see init_single_realisation),
+        // sharing the mode table of the current pattern, e.g., to generate an ensemble of realisations from one
+        // initialisation (see get_turb_vector_unigrid_chunk with several snapshots). Only for spect_form 0 and 1,
+        // where the modes do not depend on the random seed (for spect_form 2, call init_single_realisation instead).
+        // ******************************************************
+        if (spect_form == 2) {
+            TurbGen_printf("ERROR: get_snapshot(random_seed) requires spect_form 0 or 1 (modes independent of the seed).\n");
+            exit(-1);
+        }
+        std::vector<double> OUphases;
+        int seed = random_seed;
+        OU_noise_init(OUphases, seed);
+        std::shared_ptr<Snapshot> snap = std::make_shared<Snapshot>();
+        get_decomposition_coeffs(OUphases, snap->aka, snap->akb);
+        snap->step = step;
+        snap->table = table;
+        for (int d = 0; d < 3; d++) snap->ampl_factor[d] = ampl_factor[d];
+        return snap;
+    };
+    // ******************************************************
 
     // ******************************************************
     private: void set_number_of_components(void) {
@@ -186,6 +526,8 @@ class TurbGen
         // turbulent initial conditions, with parameters specified as inputs to the function; see descriptions below.
         // ******************************************************
         if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"entering.\n");
+        // stop a background worker of a previous initialisation, and discard its step and grids
+        async_reset();
         // set internal parameters
         this->ndim = ndim;
         this->L[X] = L[X]; // Length of box in x; used for wavenumber conversion below
@@ -209,7 +551,8 @@ class TurbGen
         set_number_of_components();
         set_solenoidal_weight_normalisation();
         // initialise modes
-        init_modes();
+        init_modes_collective();
+        init_mode_table(true);
         // initialise random phases
         OU_noise_init();
         // calculate solenoidal and compressive coefficients (aka, akb) from OUphases
@@ -232,6 +575,8 @@ class TurbGen
         // This is used for driving turbulence (as opposed to init_single_realisation, which is for creating a single pattern).
         // ******************************************************
         if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"entering.\n");
+        // stop a background worker of a previous initialisation, and discard its step and grids
+        async_reset();
         // set parameter file
         this->parameter_file = parameter_file;
         // check if parameter file is present
@@ -295,7 +640,8 @@ class TurbGen
         // set solenoidal weight normalisation
         set_solenoidal_weight_normalisation();
         // initialise modes
-        init_modes();
+        init_modes_collective();
+        init_mode_table(true);
         // initialise Ornstein-Uhlenbeck sequence
         OU_noise_init();
         // calculate solenoidal and compressive coefficients (aka, akb) from OUphases
@@ -314,6 +660,8 @@ class TurbGen
             outfilestream.clear();
         }
         if (verbose) TurbGen_printf("===============================================================================\n");
+        // start precomputing the first OU step in the background (if switched on)
+        async_launch();
         if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"exiting.\n");
         return 0;
     }; // init_driving
@@ -368,15 +716,24 @@ class TurbGen
             }
         } // if (auto_adjust_amplitude)
         // if we are here: update OU vector
+        bool coeffs_ready = false; // true if the decomposition coefficients were handed over by the background worker
         for (int is = step; is < step_requested; is++) {
-            OU_noise_update(); // this seeks to the requested OU state (updates OUphases)
+            if (async_handover(step+1)) { // take over the precomputed OU step (if available)
+                coeffs_ready = true;
+            } else {
+                OU_noise_update(); // this seeks to the requested OU state (updates OUphases)
+                coeffs_ready = false;
+                async.grids_current.clear(); // precomputed grids (if any) do not belong to this step
+            }
             step++; // update internal OU step number
             if (verbose > 1) TurbGen_printf("step = %i, time = %f\n", step, step*dt);
         }
-        get_decomposition_coeffs(); // calculate solenoidal and compressive coefficients (aka, akb) from OUphases
+        if (coeffs_ready) publish_snapshot(async.snapshot); // publish the pattern precomputed by the background worker
+        else get_decomposition_coeffs(); // calculate solenoidal and compressive coefficients (aka, akb) from OUphases
         double time_gen = step * dt;
         if (verbose) TurbGen_printf("Generated new turbulence driving pattern: #%6i, time = %e, time/t_turb = %-7.2f\n", step, time_gen, time_gen/t_decay);
         if (PE == 0) write_to_evol_file(time, ampl_factor, v_turb); // write evolution file
+        async_launch(); // start precomputing the next OU step in the background (if switched on)
         if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"exiting.\n");
         return true; // we just updated the driving pattern
     }; // check_for_update(time, v_turb)
@@ -447,54 +804,565 @@ class TurbGen
         // Note that index in return_grid[X][index] is looped with x (index i)
         // as the inner loop and with z (index k) as the outer loop.
         // ******************************************************
+        get_turb_vector_unigrid(pos_beg, pos_end, n, return_grid, NULL, NULL, NULL);
+    } // get_turb_vector_unigrid
+
+    // ******************************************************
+    public: void get_turb_vector_unigrid(const double pos_beg[], const double pos_end[], const int n[], float * return_grid[],
+                                         const double * weight, const long weight_stride[], double weighted_sum[]) {
+        // ******************************************************
+        // Same as get_turb_vector_unigrid above, but also returns the weighted sum of the returned field,
+        // weighted_sum[d] = sum_ijk weight_ijk * return_grid[d][ijk], e.g., with the density as weight for
+        // the net force of a driving field. weight[i*weight_stride[X] + j*weight_stride[Y] + k*weight_stride[Z]]
+        // is the weight of cell (i,j,k), so it can point straight into the data of a hydro code (strides in elements).
+        // The sum is accumulated while the field is generated, i.e., without another pass over the grid.
+        // If weight is NULL, no sum is computed.
+        // ******************************************************
+        get_turb_vector_unigrid(pos_beg, pos_end, n, return_grid, weight, weight_stride, weighted_sum, NULL, NULL);
+    } // get_turb_vector_unigrid (weighted)
+
+    // ******************************************************
+    public: void get_turb_vector_unigrid(const double pos_beg[], const double pos_end[], const int n[], float * return_grid[],
+                                         const double * weight, const long weight_stride[], double weighted_sum[],
+                                         double sum[], double sum_sq[]) {
+        // ******************************************************
+        // Same as the weighted get_turb_vector_unigrid above, but also returns the sum, sum[d] = sum_ijk return_grid[d][ijk],
+        // and the sum of squares, sum_sq[d] = sum_ijk return_grid[d][ijk]^2, of the returned field (e.g., to normalise
+        // turbulent initial conditions without evaluating the field twice). Each sum is only computed if its pointer is not NULL.
+        // ******************************************************
+        // return_grid[d] is contiguous, with x as the inner and z as the outer index
+        const long stride[3] = {1, (long)n[X], (long)n[X]*n[Y]};
+        const long offset[3] = {0, 0, 0};
+        get_turb_vector_unigrid_strided(pos_beg, pos_end, n, NULL, return_grid, stride, offset,
+                                        weight, weight_stride, weighted_sum, sum, sum_sq);
+    } // get_turb_vector_unigrid (sums)
+
+    // ******************************************************
+    public: template <typename T> void get_turb_vector_unigrid_strided(
+                const double pos_beg[], const double pos_end[], const int n[],
+                T * base[], const long stride[], const long offset[]) {
+        // ******************************************************
+        // Same as get_turb_vector_unigrid, but writes component d of cell (i,j,k) directly into
+        // base[d][offset[d] + i*stride[X] + j*stride[Y] + k*stride[Z]] (strides and offsets in elements of type T;
+        // T = float or double). This allows writing straight into the solution arrays of a hydro code, e.g.,
+        // variable-major storage with guard cells, or into interleaved (vx,vy,vz) buffers (offset[d] = d, stride[X] = 3),
+        // without scratch buffers and copies.
+        // ******************************************************
+        get_turb_vector_unigrid_strided(pos_beg, pos_end, n, NULL, base, stride, offset, NULL, NULL, NULL, NULL, NULL);
+    } // get_turb_vector_unigrid_strided
+
+    // ******************************************************
+    public: template <typename T> void get_turb_vector_unigrid_strided(
+                const double pos_beg[], const double pos_end[], const int n[], const int nguard[],
+                T * base[], const long stride[], const long offset[],
+                const double * weight, const long weight_stride[], double weighted_sum[],
+                double sum[], double sum_sq[]) {
+        // ******************************************************
+        // Strided version of get_turb_vector_unigrid with the optional sums of the returned field (see above).
+        // If nguard is not NULL, the field is also evaluated in nguard[d] guard cells on either side of the
+        // n[d] cells between pos_beg[d] and pos_end[d] (requires n[d] > 1 where nguard[d] > 0), i.e., guard cells
+        // of a hydro code can be filled analytically, instead of by a guard-cell exchange. Cell indices (i,j,k)
+        // of the guard cells are then negative or >= n[d], and base, offset, and weight still refer to the first
+        // non-guard cell (i,j,k) = (0,0,0). The sums only include the non-guard cells.
+        // ******************************************************
+        for (int d = 0; d < 3; d++) {
+            if (weight) weighted_sum[d] = 0.0;
+            if (sum) sum[d] = 0.0;
+            if (sum_sq) sum_sq[d] = 0.0;
+        }
         if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"entering.\n");
         if (verbose > 1) TurbGen_printf("pos_beg = %f %f %f, pos_end = %f %f %f, n = %i %i %i\n",
                 pos_beg[X], pos_beg[Y], pos_beg[Z], pos_end[X], pos_end[Y], pos_end[Z], n[X], n[Y], n[Z]);
+        int ng[3] = {0, 0, 0}; // number of guard cells
+        for (int d = 0; d < 3; d++) {
+            if (nguard) ng[d] = nguard[d];
+            if ((ng[d] > 0) && (n[d] < 2)) {
+                TurbGen_printf("ERROR: guard cells require at least 2 grid cells in that direction.\n");
+                exit(-1);
+            }
+        }
+        // use (and remember) grids precomputed by the background worker (see set_async_update)
+        if (async.precompute_grids) {
+            int ig = async_request_grid(pos_beg, pos_end, n, ng);
+            if (ig >= 0) {
+                async_copy_grid(ig, *get_snapshot(), n, ng, base, stride, offset, weight, weight_stride, weighted_sum, sum, sum_sq);
+                if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"exiting (returned precomputed grid).\n");
+                return;
+            }
+        }
+        compute_turb_vector_unigrid(*get_snapshot(), pos_beg, pos_end, n, ng, base, stride, offset, true,
+                                    weight, weight_stride, weighted_sum, sum, sum_sq);
+        if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"exiting.\n");
+    } // get_turb_vector_unigrid_strided
+
+    // ******************************************************
+    public: void get_turb_vector_unigrid(const SnapshotHandle & snap,
+                                         const double pos_beg[], const double pos_end[], const int n[], float * return_grid[]) const {
+        // ******************************************************
+        // Same as get_turb_vector_unigrid above, but evaluates the pattern 'snap' (see get_snapshot).
+        // Re-entrant: can be called concurrently from several threads, also while check_for_update runs.
+        // ******************************************************
+        const long stride[3] = {1, (long)n[X], (long)n[X]*n[Y]};
+        const long offset[3] = {0, 0, 0};
+        const int ng[3] = {0, 0, 0};
+        compute_turb_vector_unigrid(*snap, pos_beg, pos_end, n, ng, return_grid, stride, offset, true, NULL, NULL, NULL, NULL, NULL);
+    } // get_turb_vector_unigrid (snapshot)
 
-        // compute output grid cell width (dx, dy, dz)
+    // ******************************************************
+    public: void get_turb_vector_unigrid_chunk(const double pos_beg[], const double pos_end[], const long n[],
+                                               const long chunk_beg[], const int chunk_n[], float * return_grid[]) const {
+        // ******************************************************
+        // Compute the chunk of cells [chunk_beg[d], chunk_beg[d]+chunk_n[d]) of the uniform grid with n[d] cells
+        // (64-bit, e.g., 4096^3 cells in total) between pos_beg[d] and pos_end[d], i.e., a sub-extent of the grid
+        // of get_turb_vector_unigrid, for grids that do not fit into memory at once (e.g., streamed in z-slabs, or
+        // decomposed over MPI ranks). The cell width and the resolved modes (see set_mode_truncation) are those of
+        // the whole grid, and cell (i,j,k) of the chunk is at pos_beg[d] + (chunk_beg[d]+i)*del[d], so the chunks
+        // are bit-identical to the corresponding cells of the whole grid, for any chunking.
+        // Return into return_grid[ndim], contiguous with chunk_n[X]*chunk_n[Y]*chunk_n[Z] cells (x inner, z outer).
+        // ******************************************************
+        SnapshotHandle snap = get_snapshot();
+        const ModeTable & tab = *snap->table;
         double del[3] = {1.0, 1.0, 1.0};
-        for (int d = 0; d < (int)ndim; d++) if (n[d] > 1) del[d] = (pos_end[d] - pos_beg[d]) / (n[d]-1);
-        // pre-compute amplitude including normalisation factors
-        std::vector<double> ampl(nmodes);
-        for (int m = 0; m < nmodes; m++) ampl[m] = 2.0 * sol_weight_norm * this->ampl[m];
-        // pre-compute grid position geometry, and trigonometry, to speed-up loops over modes below
-        std::vector< std::vector<double> > sinxi(n[X], std::vector<double>(nmodes));
-        std::vector< std::vector<double> > cosxi(n[X], std::vector<double>(nmodes));
-        std::vector< std::vector<double> > sinyj(n[Y], std::vector<double>(nmodes));
-        std::vector< std::vector<double> > cosyj(n[Y], std::vector<double>(nmodes));
-        std::vector< std::vector<double> > sinzk(n[Z], std::vector<double>(nmodes));
-        std::vector< std::vector<double> > coszk(n[Z], std::vector<double>(nmodes));
-        for (int m = 0; m < nmodes; m++) {
-            for (int i = 0; i < n[X]; i++) {
-                sinxi[i][m] = sin(mode[X][m]*(pos_beg[X]+i*del[X]));
-                cosxi[i][m] = cos(mode[X][m]*(pos_beg[X]+i*del[X]));
+        int n_res[3] = {1, 1, 1}; // only whether the whole grid has more than one cell (for the resolved modes)
+        for (int d = 0; d < (int)tab.ndim; d++) if (n[d] > 1) { del[d] = (pos_end[d] - pos_beg[d]) / (n[d]-1); n_res[d] = 2; }
+        double k_cut;
+        const int nmodes_eval = get_nmodes_resolved(tab, n_res, del, k_cut);
+        TrigTable trig[3];
+        for (int dir = X; dir <= Z; dir++) compute_trig_table(tab, dir, pos_beg[dir], del[dir], chunk_beg[dir], chunk_n[dir], nmodes_eval, trig[dir]);
+        const TrigTable * trig_ptr[3] = {&trig[X], &trig[Y], &trig[Z]};
+        const long stride[3] = {1, (long)chunk_n[X], (long)chunk_n[X]*chunk_n[Y]};
+        const long offset[3] = {0, 0, 0};
+        const int ng[3] = {0, 0, 0};
+        compute_turb_vector_unigrid(*snap, chunk_n, ng, nmodes_eval, k_cut, trig_ptr, return_grid, stride, offset, true,
+                                    NULL, NULL, NULL, NULL, NULL);
+    } // get_turb_vector_unigrid_chunk
+
+    // ******************************************************
+    public: void get_turb_vector_unigrid_chunk(const std::vector<SnapshotHandle> & snaps,
+                                               const double pos_beg[], const double pos_end[], const long n[],
+                                               const long chunk_beg[], const int chunk_n[], float ** return_grids[]) const {
+        // ******************************************************
+        // Same as get_turb_vector_unigrid_chunk above, but for several patterns 'snaps' that share the mode table,
+        // e.g., an ensemble of realisations with different random seeds (see get_snapshot(random_seed)), evaluated
+        // in one pass over the trigonometric tables of the modes; pattern r is returned into return_grids[r][ndim],
+        // bit-identical to get_turb_vector_unigrid_chunk of that pattern alone.
+        // ******************************************************
+        if (snaps.empty()) return;
+        const ModeTable & tab = *snaps[0]->table;
+        double del[3] = {1.0, 1.0, 1.0};
+        int n_res[3] = {1, 1, 1}; // only whether the whole grid has more than one cell (for the resolved modes)
+        for (int d = 0; d < (int)tab.ndim; d++) if (n[d] > 1) { del[d] = (pos_end[d] - pos_beg[d]) / (n[d]-1); n_res[d] = 2; }
+        double k_cut;
+        const int nmodes_eval = get_nmodes_resolved(tab, n_res, del, k_cut);
+        TrigTable trig[3];
+        for (int dir = X; dir <= Z; dir++) compute_trig_table(tab, dir, pos_beg[dir], del[dir], chunk_beg[dir], chunk_n[dir], nmodes_eval, trig[dir]);
+        const TrigTable * trig_ptr[3] = {&trig[X], &trig[Y], &trig[Z]};
+        compute_turb_vector_unigrid(snaps, chunk_n, nmodes_eval, k_cut, trig_ptr, return_grids);
+    } // get_turb_vector_unigrid_chunk (several patterns)
+
+    // ******************************************************
+    public: template <typename T> void get_turb_vector_multiblock(const int nblocks,
+                const double pos_beg[], const double pos_end[], const int n[], T * out[]) {
+        // ******************************************************
+        // Evaluate the turbulent vector field on nblocks uniform grids (blocks) in one call, e.g., once per
+        // pattern update for all blocks of an AMR rank. Block b has start and end coordinates pos_beg[3*b+d]
+        // and pos_end[3*b+d], and n[3*b+d] cells (as in get_turb_vector_unigrid), and component d of the field
+        // is returned into out[3*b+d] (contiguous, with x as the inner and z as the outer index).
+        // ******************************************************
+        std::vector<long> stride(3*nblocks);
+        for (int b = 0; b < nblocks; b++) {
+            stride[3*b+X] = 1; stride[3*b+Y] = n[3*b+X]; stride[3*b+Z] = (long)n[3*b+X]*n[3*b+Y];
+        }
+        get_turb_vector_multiblock(nblocks, pos_beg, pos_end, n, (const int *)NULL, out, &stride[0],
+                                   (const double * const *)NULL, (const long *)NULL, NULL, NULL, NULL);
+    } // get_turb_vector_multiblock
+
+    // ******************************************************
+    public: template <typename T> void get_turb_vector_multiblock(const int nblocks,
+                const double pos_beg[], const double pos_end[], const int n[], const int nguard[],
+                T * out[], const long stride[],
+                const double * const weight[], const long weight_stride[], double weighted_sum[],
+                double sum[], double sum_sq[]) {
+        // ******************************************************
+        // Same as above, but with the options of get_turb_vector_unigrid_strided for each block b: component d of
+        // cell (i,j,k) goes into out[3*b+d][i*stride[3*b+X] + j*stride[3*b+Y] + k*stride[3*b+Z]], nguard[3*b+d]
+        // guard cells (nguard may be NULL), and the sums weighted_sum[3*b+d] (with weight[b], weight_stride[3*b+d]),
+        // sum[3*b+d], and sum_sq[3*b+d] of the block (each only if not NULL).
+        // The blocks are distributed over the threads set with set_nthreads (work stealing, so blocks of different
+        // size balance), and the sin/cos tables of the cell positions are computed only once for all blocks that
+        // share the same cell coordinates in a direction (e.g., blocks in the same row of an AMR level).
+        // With set_async_update(..., true), blocks precomputed by the background worker are copied, and the
+        // remaining ones are computed as above.
+        // ******************************************************
+        if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"entering (%i blocks).\n", nblocks);
+        if (nblocks <= 0) return;
+        std::vector<int> ng(3*nblocks, 0);
+        if (nguard) for (int i = 0; i < 3*nblocks; i++) ng[i] = nguard[i];
+        for (int b = 0; b < nblocks; b++) {
+            for (int d = 0; d < 3; d++) {
+                if ((ng[3*b+d] > 0) && (n[3*b+d] < 2)) {
+                    TurbGen_printf("ERROR: guard cells require at least 2 grid cells in that direction.\n");
+                    exit(-1);
+                }
+                if (weight && weight[b]) weighted_sum[3*b+d] = 0.0;
+                if (sum) sum[3*b+d] = 0.0;
+                if (sum_sq) sum_sq[3*b+d] = 0.0;
             }
-            for (int j = 0; j < n[Y]; j++) {
-                if ((int)ndim > 1) {
-                    sinyj[j][m] = sin(mode[Y][m]*(pos_beg[Y]+j*del[Y]));
-                    cosyj[j][m] = cos(mode[Y][m]*(pos_beg[Y]+j*del[Y]));
-                } else {
-                    sinyj[j][m] = 0.0;
-                    cosyj[j][m] = 1.0;
+        }
+        SnapshotHandle snap = get_snapshot();
+        // blocks precomputed by the background worker (see set_async_update) are copied, the others are computed
+        std::vector<int> block_grid(nblocks, -1); // index of the precomputed grid of block b (or -1)
+        if (async.precompute_grids)
+            for (int b = 0; b < nblocks; b++) block_grid[b] = async_request_grid(&pos_beg[3*b], &pos_end[3*b], &n[3*b], &ng[3*b]);
+        // find the distinct sets of cell coordinates in each direction, and the table of each block and direction
+        std::vector<int> table_dir; // direction of each table
+        std::vector<double> table_pos_first, table_del; // first coordinate and cell width of each table
+        std::vector<int> table_nt; // number of cells of each table
+        std::vector<int> table_nmodes; // number of modes of each table (the most needed by any of its blocks)
+        std::vector<int> block_table(3*nblocks); // index of the table of block b in direction d
+        std::vector<double> block_del(3*nblocks); // cell width of block b
+        for (int b = 0; b < nblocks; b++) {
+            if (block_grid[b] >= 0) continue;
+            double pos_first[3]; double * del = &block_del[3*b]; int nt[3];
+            unigrid_geometry(*snap->table, &pos_beg[3*b], &pos_end[3*b], &n[3*b], &ng[3*b], pos_first, del, nt);
+            double k_cut;
+            const int nmodes_eval = get_nmodes_resolved(*snap->table, &n[3*b], del, k_cut);
+            for (int dir = X; dir <= Z; dir++) {
+                int it = 0;
+                for (; it < (int)table_dir.size(); it++)
+                    if ((table_dir[it] == dir) && (table_pos_first[it] == pos_first[dir]) &&
+                        (table_del[it] == del[dir]) && (table_nt[it] == nt[dir])) break;
+                if (it == (int)table_dir.size()) {
+                    table_dir.push_back(dir); table_pos_first.push_back(pos_first[dir]);
+                    table_del.push_back(del[dir]); table_nt.push_back(nt[dir]); table_nmodes.push_back(0);
                 }
+                table_nmodes[it] = std::max(table_nmodes[it], nmodes_eval);
+                block_table[3*b+dir] = it;
+            }
+        }
+        if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"%i distinct sin/cos tables for %i blocks.\n", (int)table_dir.size(), nblocks);
+        // compute the tables, and then the blocks
+        std::vector<TrigTable> tables(table_dir.size());
+        parallel_for((int)tables.size(), [&](const int it) {
+            compute_trig_table(*snap->table, table_dir[it], table_pos_first[it], table_del[it], 0, table_nt[it], table_nmodes[it], tables[it]);
+        });
+        parallel_for(nblocks, [&](const int b) {
+            const long offset[3] = {0, 0, 0};
+            const bool have_weight = weight && weight[b];
+            if (block_grid[b] >= 0) {
+                async_copy_grid(block_grid[b], *snap, &n[3*b], &ng[3*b], &out[3*b], &stride[3*b], offset,
+                    have_weight ? weight[b] : NULL, have_weight ? &weight_stride[3*b] : NULL, have_weight ? &weighted_sum[3*b] : NULL,
+                    sum ? &sum[3*b] : NULL, sum_sq ? &sum_sq[3*b] : NULL);
+                return;
             }
+            const TrigTable * trig[3] = {&tables[block_table[3*b+X]], &tables[block_table[3*b+Y]], &tables[block_table[3*b+Z]]};
+            double k_cut;
+            const int nmodes_eval = get_nmodes_resolved(*snap->table, &n[3*b], &block_del[3*b], k_cut);
+            compute_turb_vector_unigrid(*snap, &n[3*b], &ng[3*b], nmodes_eval, k_cut, trig, &out[3*b], &stride[3*b], offset, true,
+                have_weight ? weight[b] : NULL, have_weight ? &weight_stride[3*b] : NULL, have_weight ? &weighted_sum[3*b] : NULL,
+                sum ? &sum[3*b] : NULL, sum_sq ? &sum_sq[3*b] : NULL);
+        });
+        if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"exiting.\n");
+    } // get_turb_vector_multiblock (strided)
+
+    // ******************************************************
+    public: void get_turb_vector_unigrid_interpolated(const double pos_beg[], const double pos_end[], const int n[],
+                                                      float * return_grid[], const double tolerance, double & error_bound) {
+        // ******************************************************
+        // Same as get_turb_vector_unigrid, but for large grids of band-limited fields (e.g., driving with k <~ 3):
+        // the field is only evaluated on a coarser lattice, chosen such that the interpolation error stays below
+        // 'tolerance' times the rms of the field, and the requested grid is then reconstructed by 6-point
+        // (6th-order) Lagrange interpolation in each direction (tensor product). The cell width of the coarse
+        // lattice is an integer multiple of the requested cell width in each direction. Returns the upper bound
+        // of the absolute interpolation error of each component in 'error_bound', from the Lagrange remainder
+        // |f - p| <= max|w(x)|/6! * max|d^6 f/dx^6| with max|d^6 f/dx^6| <= sum_m |k_m|^6 |a_m|, accumulated over
+        // the directions with the Lebesgue constant of the stencil (excluding the rounding to float). Directions in which no coarsening pays off
+        // (e.g., high k) are evaluated directly, so this always returns a field of at least the requested accuracy.
+        // ******************************************************
+        if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"entering.\n");
+        const int ns = 6; // stencil size (nodes -2, -1, 0, 1, 2, 3 relative to the coarse node at or below x)
+        const int s0 = 2; // number of stencil nodes below that coarse node
+        SnapshotHandle snap = get_snapshot();
+        const ModeTable & tab = *snap->table;
+        const int ncmp = tab.ncmp;
+        // cell width of the requested grid, and the modes it resolves (all modes, unless set_mode_truncation)
+        double del[3] = {1.0, 1.0, 1.0};
+        for (int d = 0; d < (int)tab.ndim; d++) if (n[d] > 1) del[d] = (pos_end[d] - pos_beg[d]) / (n[d]-1);
+        double k_cut;
+        const int nmodes_eval = get_nmodes_resolved(tab, n, del, k_cut);
+        // rms of the field, and upper bound of the 6th derivative in each direction (d6f[d])
+        double rms = 0.0, d6f[3] = {0.0, 0.0, 0.0};
+        for (int c = 0; c < ncmp; c++) {
+            double var = 0.0, d6f_c[3] = {0.0, 0.0, 0.0};
+            for (int m = 0; m < nmodes_eval; m++) {
+                const double a = fabs(tab.ampl[m] * snap->ampl_factor[c]) *
+                                 sqrt(snap->aka[c][m]*snap->aka[c][m] + snap->akb[c][m]*snap->akb[c][m]);
+                var += 0.5 * a * a;
+                for (int d = 0; d < (int)tab.ndim; d++) d6f_c[d] += pow(fabs(tab.mode[d][m]), 6.0) * a;
+            }
+            rms += var / ncmp;
+            for (int d = 0; d < 3; d++) d6f[d] = std::max(d6f[d], d6f_c[d]);
+        }
+        rms = sqrt(rms);
+        // stencil constants: max|w(t)| = max|prod_s (t-s)| and Lebesgue constant for t in [0, 1] (in units of the coarse cell width)
+        double w_max = 0.0, lebesgue = 0.0;
+        for (int it = 0; it <= 1000; it++) {
+            const double t = it / 1000.0;
+            double w = 1.0, l[ns];
+            for (int s = 0; s < ns; s++) w *= t - (s-s0);
+            lagrange_weights(ns, s0, t, l);
+            double leb = 0.0; for (int s = 0; s < ns; s++) leb += fabs(l[s]);
+            w_max = std::max(w_max, fabs(w)); lebesgue = std::max(lebesgue, leb);
+        }
+        const double c6 = w_max / 720.0;
+        // coarsening ratio r[d] of each direction; the passes go in z, y, x, so the error of direction d is amplified
+        // by the Lebesgue constant of each later pass (directions < d); the tolerance is split evenly among the directions
+        int r[3] = {1, 1, 1};
+        int ncand = 0;
+        for (int d = 0; d < (int)tab.ndim; d++) if ((n[d] > 1) && (d6f[d] > 0.0)) ncand++;
+        for (int d = 0; d < (int)tab.ndim; d++) {
+            if ((n[d] <= 1) || (d6f[d] <= 0.0) || (tolerance <= 0.0)) continue;
+            int nlater = 0; for (int dd = 0; dd < d; dd++) if ((n[dd] > 1) && (d6f[dd] > 0.0)) nlater++;
+            const double h = pow(tolerance * rms / ncand / (c6 * d6f[d] * pow(lebesgue, nlater)), 1.0/6.0);
+            r[d] = std::max(1, std::min((int)floor(h/del[d]), n[d]-1));
+        }
+        // error bound for the chosen coarsening
+        error_bound = 0.0;
+        for (int d = 0; d < 3; d++) {
+            if (r[d] == 1) continue;
+            int nlater = 0; for (int dd = 0; dd < d; dd++) if (r[dd] > 1) nlater++;
+            error_bound += pow(lebesgue, nlater) * c6 * pow(r[d]*del[d], 6.0) * d6f[d];
+        }
+        // coarse lattice: s0 nodes below and ns-s0-1 nodes above the requested grid in coarsened directions
+        int nc[3]; double pos_beg_c[3], pos_end_c[3];
+        for (int d = 0; d < 3; d++) {
+            if (r[d] == 1) { nc[d] = n[d]; pos_beg_c[d] = pos_beg[d]; pos_end_c[d] = pos_end[d]; continue; }
+            nc[d] = (n[d]-1) / r[d] + ns;
+            pos_beg_c[d] = pos_beg[d] - s0 * r[d] * del[d];
+            pos_end_c[d] = pos_beg_c[d] + (nc[d]-1) * r[d] * del[d];
+        }
+        if (verbose > 1) TurbGen_printf("Evaluating %i x %i x %i instead of %i x %i x %i cells (coarsening %i %i %i); "
+                                    "interpolation error bound = %e (%e of rms).\n", nc[X], nc[Y], nc[Z], n[X], n[Y], n[Z],
+                                    r[X], r[Y], r[Z], error_bound, rms > 0.0 ? error_bound/rms : 0.0);
+        const long ncx = nc[X], ncy = nc[Y], ncz = nc[Z];
+        std::vector<double> coarse[3];
+        double * coarse_ptr[3] = {NULL, NULL, NULL};
+        for (int d = 0; d < ncmp; d++) { coarse[d].resize(ncx*ncy*ncz); coarse_ptr[d] = &coarse[d][0]; }
+        const long stride_c[3] = {1, ncx, ncx*ncy};
+        const long offset[3] = {0, 0, 0};
+        const int ng[3] = {0, 0, 0};
+        compute_turb_vector_unigrid(*snap, pos_beg_c, pos_end_c, nc, ng, coarse_ptr, stride_c, offset, true,
+                                    NULL, NULL, NULL, NULL, NULL);
+        // interpolation weights for each fine position within a coarse cell (t = i/r)
+        std::vector<double> weights[3];
+        for (int d = 0; d < 3; d++) {
+            weights[d].resize(r[d]*ns);
+            for (int i = 0; i < r[d]; i++) lagrange_weights(ns, s0, (double)i/r[d], &weights[d][i*ns]);
+        }
+        // interpolate in z (to plane), y (to lines), and x (to the return grid)
+        std::vector<double> plane(ncx*ncy), lines(ncx*n[Y]);
+        for (int c = 0; c < ncmp; c++) {
             for (int k = 0; k < n[Z]; k++) {
-                if ((int)ndim > 2) {
-                    sinzk[k][m] = sin(mode[Z][m]*(pos_beg[Z]+k*del[Z]));
-                    coszk[k][m] = cos(mode[Z][m]*(pos_beg[Z]+k*del[Z]));
+                if (r[Z] == 1) std::copy(&coarse[c][k*ncx*ncy], &coarse[c][k*ncx*ncy] + ncx*ncy, plane.begin());
+                else {
+                    const double * w = &weights[Z][(k % r[Z])*ns];
+                    const long base = (k / r[Z]) * ncx*ncy;
+                    for (long ij = 0; ij < ncx*ncy; ij++) {
+                        double val = 0.0;
+                        for (int s = 0; s < ns; s++) val += w[s] * coarse[c][base + s*ncx*ncy + ij];
+                        plane[ij] = val;
+                    }
+                }
+                for (int j = 0; j < n[Y]; j++) {
+                    if (r[Y] == 1) std::copy(&plane[j*ncx], &plane[j*ncx] + ncx, &lines[j*ncx]);
+                    else {
+                        const double * w = &weights[Y][(j % r[Y])*ns];
+                        const long base = (j / r[Y]) * ncx;
+                        for (long i = 0; i < ncx; i++) {
+                            double val = 0.0;
+                            for (int s = 0; s < ns; s++) val += w[s] * plane[base + s*ncx + i];
+                            lines[j*ncx + i] = val;
+                        }
+                    }
+                }
+                for (int j = 0; j < n[Y]; j++) {
+                    float * out = &return_grid[c][(long)k*n[X]*n[Y] + (long)j*n[X]];
+                    if (r[X] == 1) for (int i = 0; i < n[X]; i++) out[i] = lines[j*ncx + i];
+                    else {
+                        for (int i = 0; i < n[X]; i++) {
+                            const double * w = &weights[X][(i % r[X])*ns];
+                            const double * in = &lines[j*ncx + i / r[X]];
+                            double val = 0.0;
+                            for (int s = 0; s < ns; s++) val += w[s] * in[s];
+                            out[i] = val;
+                        }
+                    }
+                }
+            }
+        }
+        if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"exiting.\n");
+    } // get_turb_vector_unigrid_interpolated
+
+    // ******************************************************
+    private: void lagrange_weights(const int ns, const int s0, const double t, double w[]) const {
+        // ******************************************************
+        // weights w[s] of the Lagrange polynomial through the nodes s-s0 (s in [0, ns)) at position t
+        // ******************************************************
+        for (int s = 0; s < ns; s++) {
+            w[s] = 1.0;
+            for (int q = 0; q < ns; q++) if (q != s) w[s] *= (t - (q-s0)) / (double)(s - q);
+        }
+    }; // lagrange_weights
+
+    // ******************************************************
+    private: template <typename F> void parallel_for(const int ntasks, const F & task) const {
+        // ******************************************************
+        // Execute task(i) for i in [0, ntasks) on up to nthreads threads (the caller is one of them). Each thread
+        // starts on its own contiguous range of tasks and, once that is done, steals the remaining tasks of the
+        // other ranges, so that tasks of unequal cost are balanced. Tasks must be independent.
+        // ******************************************************
+#ifdef HAVE_THREADS
+        const int nth = std::min(nthreads, ntasks);
+        if (nth > 1) {
+            std::unique_ptr< std::atomic<int>[] > next(new std::atomic<int>[nth]); // next task of each range
+            std::vector<int> end(nth); // end of each range
+            for (int t = 0; t < nth; t++) {
+                next[t].store((long)ntasks*t/nth);
+                end[t] = (long)ntasks*(t+1)/nth;
+            }
+            auto worker = [&](const int t) {
+                for (int r = 0; r < nth; r++) { // own range first, then the others
+                    const int range = (t+r) % nth;
+                    for (int i = next[range].fetch_add(1); i < end[range]; i = next[range].fetch_add(1)) task(i);
+                }
+            };
+            std::vector<std::thread> pool;
+            for (int t = 1; t < nth; t++) pool.push_back(std::thread(worker, t));
+            worker(0);
+            for (unsigned int t = 0; t < pool.size(); t++) pool[t].join();
+            return;
+        }
+#endif
+        for (int i = 0; i < ntasks; i++) task(i);
+    }; // parallel_for
+
+
+    // ******************************************************
+    private: template <typename T> void compute_turb_vector_unigrid(const Snapshot & snap,
+                                              const double pos_beg[], const double pos_end[], const int n[], const int ng[],
+                                              T * const base[], const long stride[], const long offset[],
+                                              const bool apply_ampl_factor,
+                                              const double * weight, const long weight_stride[], double weighted_sum[],
+                                              double sum[], double sum_sq[]) const {
+        // ******************************************************
+        // Uniform-grid kernel of get_turb_vector_unigrid[_strided] for the pattern 'snap', writing component d
+        // of cell (i,j,k) into base[d][offset[d] + i*stride[X] + j*stride[Y] + k*stride[Z]], for i in [-ng[X], n[X]+ng[X])
+        // etc. (with ng guard cells); only reads from 'snap', so it is safe to call concurrently.
+        // The sums of the returned field (if not NULL; see get_turb_vector_unigrid) are accumulated on the fly.
+        // ******************************************************
+        double pos_first[3]; double del[3]; int nt[3];
+        unigrid_geometry(*snap.table, pos_beg, pos_end, n, ng, pos_first, del, nt);
+        double k_cut; // only modes resolved by the grid (see set_mode_truncation)
+        const int nmodes_eval = get_nmodes_resolved(*snap.table, n, del, k_cut);
+        // pre-compute grid position geometry, and trigonometry, to speed-up loops over modes below
+        TrigTable trig[3];
+        for (int dir = X; dir <= Z; dir++) compute_trig_table(*snap.table, dir, pos_first[dir], del[dir], 0, nt[dir], nmodes_eval, trig[dir]);
+        const TrigTable * trig_ptr[3] = {&trig[X], &trig[Y], &trig[Z]};
+        compute_turb_vector_unigrid(snap, n, ng, nmodes_eval, k_cut, trig_ptr, base, stride, offset, apply_ampl_factor,
+                                    weight, weight_stride, weighted_sum, sum, sum_sq);
+    } // compute_turb_vector_unigrid
+
+    // ******************************************************
+    private: void unigrid_geometry(const ModeTable & tab, const double pos_beg[], const double pos_end[], const int n[], const int ng[],
+                                   double pos_first[], double del[], int nt[]) const {
+        // ******************************************************
+        // uniform-grid cell width del (dx, dy, dz), first evaluated cell coordinate pos_first,
+        // and number of evaluated cells nt (including ng guard cells on either side)
+        // ******************************************************
+        for (int d = 0; d < 3; d++) del[d] = 1.0;
+        for (int d = 0; d < (int)tab.ndim; d++) if (n[d] > 1) del[d] = (pos_end[d] - pos_beg[d]) / (n[d]-1);
+        for (int d = 0; d < 3; d++) {
+            pos_first[d] = pos_beg[d] - ng[d]*del[d];
+            nt[d] = n[d] + 2*ng[d];
+        }
+    }; // unigrid_geometry
+
+    // ******************************************************
+    private: int get_nmodes_resolved(const ModeTable & tab, const int n[], const double del[], double & k_cut) const {
+        // ******************************************************
+        // return the number of leading modes in 'tab' with |k| <= k_cut = pi/max(del) (over the directions with n > 1),
+        // i.e., the modes resolved by the grid, if the table is sorted by |k| (see set_mode_truncation); else all modes
+        // ******************************************************
+        k_cut = DBL_MAX;
+        if (!tab.kabs) return tab.nmodes;
+        double del_max = 0.0;
+        for (int d = 0; d < (int)tab.ndim; d++) if (n[d] > 1) del_max = std::max(del_max, del[d]);
+        if (del_max <= 0.0) return tab.nmodes;
+        k_cut = M_PI / del_max;
+        return std::upper_bound(tab.kabs, tab.kabs+tab.nmodes, k_cut) - tab.kabs;
+    }; // get_nmodes_resolved
+
+    // ******************************************************
+    private: void compute_trig_table(const ModeTable & tab, const int dir, const double pos_first, const double del,
+                                     const long first, const int nt, const int nmodes, TrigTable & trig) const {
+        // ******************************************************
+        // sin and cos of mode[dir][m] * (pos_first + (first+i)*del) for i in [0, nt) and the first nmodes modes
+        // (sin = 0, cos = 1 for dir >= ndim); first > 0 for a chunk of a larger grid (see get_turb_vector_unigrid_chunk)
+        // ******************************************************
+        const double * mode = tab.mode[dir];
+        trig.sin.assign(nt, std::vector<double>(nmodes));
+        trig.cos.assign(nt, std::vector<double>(nmodes));
+        for (int i = 0; i < nt; i++) {
+            for (int m = 0; m < nmodes; m++) {
+                if (dir < (int)tab.ndim) {
+                    trig.sin[i][m] = sin(mode[m]*(pos_first+(first+i)*del));
+                    trig.cos[i][m] = cos(mode[m]*(pos_first+(first+i)*del));
                 } else {
-                    sinzk[k][m] = 0.0;
-                    coszk[k][m] = 1.0;
+                    trig.sin[i][m] = 0.0;
+                    trig.cos[i][m] = 1.0;
                 }
             }
         }
+    }; // compute_trig_table
+
+    // ******************************************************
+    private: template <typename T> void compute_turb_vector_unigrid(const Snapshot & snap, const int n[], const int ng[],
+                                              const int nmodes, const double k_cut, const TrigTable * const trig[],
+                                              T * const base[], const long stride[], const long offset[],
+                                              const bool apply_ampl_factor,
+                                              const double * weight, const long weight_stride[], double weighted_sum[],
+                                              double sum[], double sum_sq[]) const {
+        // ******************************************************
+        // Same as compute_turb_vector_unigrid above, but with the precomputed trigonometry trig[X,Y,Z] of the
+        // n[d]+2*ng[d] evaluated positions in each direction (see compute_trig_table), e.g., shared between blocks,
+        // evaluating the first nmodes modes with |k| <= k_cut, i.e., those resolved
+        // by the grid (see get_nmodes_resolved; the tables must include at least these modes).
+        // ******************************************************
+        const bool have_sums = weight || sum || sum_sq;
+        const ModeTable & tab = *snap.table;
+        const int ncmp = tab.ncmp;
+        std::vector<double> ampl_taper; // amplitudes with cos^2 taper below k_cut
+        const double * ampl = get_tapered_amplitudes(tab, nmodes, k_cut, ampl_taper);
+        if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"evaluating %i of %i modes.\n", nmodes, tab.nmodes);
+        const std::vector<double> * aka = snap.aka;
+        const std::vector<double> * akb = snap.akb;
+        double ampl_factor[3] = {1.0, 1.0, 1.0};
+        if (apply_ampl_factor) for (int d = 0; d < 3; d++) ampl_factor[d] = snap.ampl_factor[d];
+        const int nt[3] = {n[X]+2*ng[X], n[Y]+2*ng[Y], n[Z]+2*ng[Z]};
+        const std::vector< std::vector<double> > & sinxi = trig[X]->sin;
+        const std::vector< std::vector<double> > & cosxi = trig[X]->cos;
+        const std::vector< std::vector<double> > & sinyj = trig[Y]->sin;
+        const std::vector< std::vector<double> > & cosyj = trig[Y]->cos;
+        const std::vector< std::vector<double> > & sinzk = trig[Z]->sin;
+        const std::vector< std::vector<double> > & coszk = trig[Z]->cos;
         // scratch variables
         double v[3];
+        double val[3] = {0.0, 0.0, 0.0};
         double real, imag;
-        // loop over cells in return_grid
-        for (int k = 0; k < n[Z]; k++) {
-            for (int j = 0; j < n[Y]; j++) {
-                for (int i = 0; i < n[X]; i++) {
+        // loop over cells in return grid
+        for (int k = 0; k < nt[Z]; k++) {
+            for (int j = 0; j < nt[Y]; j++) {
+                for (int i = 0; i < nt[X]; i++) {
                     // clear
                     v[X] = 0.0; v[Y] = 0.0; v[Z] = 0.0;
                     // loop over modes
@@ -511,32 +1379,147 @@ class TurbGen
                         if (ncmp > 2) v[Z] += ampl[m] * (aka[Z][m]*real - akb[Z][m]*imag);
                     }
                     // copy into return grid
-                    long index = k*n[X]*n[Y] + j*n[X] + i;
-                    return_grid[X][index] = v[X] * ampl_factor[X];
-                    if (ncmp > 1) return_grid[Y][index] = v[Y] * ampl_factor[Y];
-                    if (ncmp > 2) return_grid[Z][index] = v[Z] * ampl_factor[Z];
+                    long index = (i-ng[X])*stride[X] + (j-ng[Y])*stride[Y] + (k-ng[Z])*stride[Z];
+                    for (int d = 0; d < ncmp; d++) {
+                        T out = v[d] * ampl_factor[d];
+                        base[d][offset[d] + index] = out;
+                        val[d] = out;
+                    }
+                    // accumulate sums (of the returned values, i.e., after conversion to T)
+                    if (have_sums && (i >= ng[X]) && (i < n[X]+ng[X]) && (j >= ng[Y]) && (j < n[Y]+ng[Y]) && (k >= ng[Z]) && (k < n[Z]+ng[Z]))
+                        add_to_unigrid_sums(ncmp, val, i-ng[X], j-ng[Y], k-ng[Z], weight, weight_stride, weighted_sum, sum, sum_sq);
                 } // i
             } // j
         } // k
-        if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"exiting.\n");
-    } // get_turb_vector_unigrid
+    } // compute_turb_vector_unigrid (tables)
+
+    // ******************************************************
+    private: void compute_turb_vector_unigrid(const std::vector<SnapshotHandle> & snaps, const int n[], const int nmodes,
+                                              const double k_cut, const TrigTable * const trig[], float ** const base[]) const {
+        // ******************************************************
+        // Same as compute_turb_vector_unigrid (tables) above, but for several patterns 'snaps' sharing the same mode
+        // table (e.g., an ensemble of realisations; see get_snapshot(random_seed)): the mode phases of each cell are
+        // computed once and applied to the coefficients of all patterns (multiple right-hand sides). Component d
+        // of cell (i,j,k) of pattern r goes into base[r][d][i + j*n[X] + k*n[X]*n[Y]] (no guard cells or sums);
+        // each pattern is bit-identical to evaluating it alone.
+        // ******************************************************
+        const int nsnaps = snaps.size();
+        if (nsnaps == 0) return;
+        const ModeTable & tab = *snaps[0]->table;
+        for (int r = 1; r < nsnaps; r++) {
+            if (snaps[r]->table != snaps[0]->table) {
+                TurbGen_printf("ERROR: the patterns must share the same mode table (see get_snapshot(random_seed)).\n");
+                exit(-1);
+            }
+        }
+        const int ncmp = tab.ncmp;
+        std::vector<double> ampl_taper; // amplitudes with cos^2 taper below k_cut
+        const double * ampl = get_tapered_amplitudes(tab, nmodes, k_cut, ampl_taper);
+        if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"evaluating %i of %i modes for %i patterns.\n", nmodes, tab.nmodes, nsnaps);
+        // coefficients of all patterns
+        std::vector<const double *> aka(3*nsnaps), akb(3*nsnaps);
+        for (int r = 0; r < nsnaps; r++) for (int d = 0; d < ncmp; d++) { aka[3*r+d] = &snaps[r]->aka[d][0]; akb[3*r+d] = &snaps[r]->akb[d][0]; }
+        const std::vector< std::vector<double> > & sinxi = trig[X]->sin;
+        const std::vector< std::vector<double> > & cosxi = trig[X]->cos;
+        const std::vector< std::vector<double> > & sinyj = trig[Y]->sin;
+        const std::vector< std::vector<double> > & cosyj = trig[Y]->cos;
+        const std::vector< std::vector<double> > & sinzk = trig[Z]->sin;
+        const std::vector< std::vector<double> > & coszk = trig[Z]->cos;
+        // scratch variables
+        std::vector<double> v(3*nsnaps);
+        double real, imag;
+        // loop over cells in return grid
+        for (int k = 0; k < n[Z]; k++) {
+            for (int j = 0; j < n[Y]; j++) {
+                for (int i = 0; i < n[X]; i++) {
+                    // clear
+                    std::fill(v.begin(), v.end(), 0.0);
+                    // loop over modes
+                    for (int m = 0; m < nmodes; m++) {
+                        // real and imaginary parts of e^{ i \vec{k} \cdot \vec{x} } (see compute_turb_vector_unigrid above)
+                        real =  ( cosxi[i][m]*cosyj[j][m] - sinxi[i][m]*sinyj[j][m] ) * coszk[k][m] -
+                                ( sinxi[i][m]*cosyj[j][m] + cosxi[i][m]*sinyj[j][m] ) * sinzk[k][m];
+                        imag =  ( cosyj[j][m]*sinzk[k][m] + sinyj[j][m]*coszk[k][m] ) * cosxi[i][m] +
+                                ( cosyj[j][m]*coszk[k][m] - sinyj[j][m]*sinzk[k][m] ) * sinxi[i][m];
+                        // accumulate v of each pattern as sum over modes
+                        for (int r = 0; r < nsnaps; r++)
+                            for (int d = 0; d < ncmp; d++) v[3*r+d] += ampl[m] * (aka[3*r+d][m]*real - akb[3*r+d][m]*imag);
+                    }
+                    // copy into return grids
+                    const long index = i + (long)j*n[X] + (long)k*n[X]*n[Y];
+                    for (int r = 0; r < nsnaps; r++)
+                        for (int d = 0; d < ncmp; d++) base[r][d][index] = v[3*r+d] * snaps[r]->ampl_factor[d];
+                } // i
+            } // j
+        } // k
+    } // compute_turb_vector_unigrid (tables, several patterns)
+
+    // ******************************************************
+    private: const double * get_tapered_amplitudes(const ModeTable & tab, const int nmodes, const double k_cut,
+                                                   std::vector<double> & ampl_taper) const {
+        // ******************************************************
+        // amplitudes of the first nmodes modes of 'tab', with the cos^2 taper below k_cut (see set_mode_truncation)
+        // in ampl_taper, if any; else the table amplitudes
+        // ******************************************************
+        if ((tab.taper > 0.0) && (k_cut < DBL_MAX)) {
+            const double k0 = (1.0 - tab.taper) * k_cut;
+            ampl_taper.resize(nmodes);
+            for (int m = 0; m < nmodes; m++) {
+                double w = 1.0;
+                if (tab.kabs[m] > k0) { w = cos(0.5*M_PI*(tab.kabs[m]-k0)/(k_cut-k0)); w *= w; }
+                ampl_taper[m] = w * tab.ampl[m];
+            }
+        }
+        return ampl_taper.empty() ? tab.ampl : &ampl_taper[0];
+    }; // get_tapered_amplitudes
+
+    // ******************************************************
+    private: inline void add_to_unigrid_sums(const int ncmp, const double val[], const int i, const int j, const int k,
+                                             const double * weight, const long weight_stride[], double weighted_sum[],
+                                             double sum[], double sum_sq[]) const {
+        // ******************************************************
+        // add the returned field val[ncmp] of cell (i,j,k) to the sums that are not NULL (see get_turb_vector_unigrid)
+        // ******************************************************
+        if (weight) {
+            const double w = weight[i*weight_stride[X] + j*weight_stride[Y] + k*weight_stride[Z]];
+            for (int d = 0; d < ncmp; d++) weighted_sum[d] += w * val[d];
+        }
+        if (sum) for (int d = 0; d < ncmp; d++) sum[d] += val[d];
+        if (sum_sq) for (int d = 0; d < ncmp; d++) sum_sq[d] += val[d] * val[d];
+    }; // add_to_unigrid_sums
 
 
     // ******************************************************
-    public: void get_turb_vector(const double pos[], double v[]) {
+    public: void get_turb_vector(const double pos[], double v[]) const {
         // ******************************************************
         // Compute physical turbulent vector v[ndim]=(vx,vy,vz) at position pos[ndim]=(x,y,z)
         // from loop over all turbulent modes; return into double v[ndim]
         // ******************************************************
+        get_turb_vector(get_snapshot(), pos, v);
+    }; // get_turb_vector
+
+    // ******************************************************
+    public: void get_turb_vector(const SnapshotHandle & snap, const double pos[], double v[]) const {
+        // ******************************************************
+        // Same as get_turb_vector above, but evaluates the pattern 'snap' (see get_snapshot).
+        // Re-entrant: can be called concurrently from several threads, also while check_for_update runs.
+        // ******************************************************
         if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"entering.\n");
+        const ModeTable & tab = *snap->table;
+        const double ndim = tab.ndim;
+        const int ncmp = tab.ncmp;
+        const int nmodes = tab.nmodes;
+        const double * const * mode = tab.mode;
+        const double * ampl = tab.ampl; // amplitudes including normalisation factors
+        const std::vector<double> * aka = snap->aka;
+        const std::vector<double> * akb = snap->akb;
+        const double * ampl_factor = snap->ampl_factor;
         // containers for speeding-up calculations below
-        std::vector<double> ampl(nmodes);
         std::vector<double> sinx(nmodes); std::vector<double> cosx(nmodes);
         std::vector<double> siny(nmodes); std::vector<double> cosy(nmodes);
         std::vector<double> sinz(nmodes); std::vector<double> cosz(nmodes);
         // pre-compute some trigonometry
         for (int m = 0; m < nmodes; m++) {
-            ampl[m] = 2.0 * sol_weight_norm * this->ampl[m]; // pre-compute amplitude including normalisation factors
             sinx[m] = sin(mode[X][m]*pos[X]);
             cosx[m] = cos(mode[X][m]*pos[X]);
             if ((int)ndim > 1) {
@@ -570,7 +1553,7 @@ class TurbGen
             if (ncmp > 2) v[Z] += ampl[m] * (aka[Z][m]*real - akb[Z][m]*imag) * ampl_factor[Z];
         }
         if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"exiting.\n");
-    }; // get_turb_vector
+    }; // get_turb_vector (snapshot)
 
 
     // ******************************************************
@@ -699,9 +1682,13 @@ class TurbGen
         int ikmin[3], ikmax[3], ik[3], tot_nmodes;
         double k[3], ka, kc, amplitude, parab_prefact;
 
+        // start from an empty mode list (the generator may be re-initialised, e.g., for another random seed)
+        for (int d = 0; d < 3; d++) mode[d].clear();
+        ampl.clear();
+
         // applies in case of power law (spect_form == 2)
         int iang, nang;
-        double rand, phi, theta;
+        double rand, phi, theta, rot[3][3], rand_offset = 0.0;
 
         // this is for spect_form = 1 (paraboloid) only
         // prefactor for amplitude normalistion to 1 at kc = 0.5*(kmin+kmax)
@@ -824,24 +1811,37 @@ class TurbGen
 
             if (verbose) TurbGen_printf("Generating turbulent modes within k = [%i, %i]\n", ikmin[0], ikmax[0]);
 
+            // if there is a budget, reduce the number of angles by angles_factor to stay within the budget
+            double angles_factor = get_angles_budget_factor(ikmin[0], ikmax[0]);
+
             for (ik[0] = ikmin[0]; ik[0] <= ikmax[0]; ik[0]++) {
 
-                nang = pow(2.0,(int)ndim) * ceil(pow((double)ik[0],angles_exp));
+                nang = pow(2.0,(int)ndim) * ceil(angles_factor*pow((double)ik[0],angles_exp));
                 if (verbose) TurbGen_printf("ik, number of angles = %i, %i\n", ik[0], nang);
 
+                // for stratified sampling: random rotation of the point set in this shell
+                if (angles_sampling == 1) { random_rotation(rot); rand_offset = ran2(&seed); }
+
                 for (iang = 1; iang <= nang; iang++) {
 
-                    phi = 2*M_PI * ran2(&seed); // phi = [0,2pi] sample the whole sphere
-                    if ((int)ndim == 1) {
-                        if (phi <  M_PI) phi = 0.0; // left
-                        if (phi >= M_PI) phi = M_PI; // right
+                    if (angles_sampling == 0) { // random angles
+                        phi = 2*M_PI * ran2(&seed); // phi = [0,2pi] sample the whole sphere
+                        if ((int)ndim == 1) {
+                            if (phi <  M_PI) phi = 0.0; // left
+                            if (phi >= M_PI) phi = M_PI; // right
+                        }
+                        theta = M_PI/2.0;
+                        if ((int)ndim > 2) theta = acos(1.0 - 2.0*ran2(&seed)); // theta = [0,pi] sample the whole sphere
+                    } else { // stratified angles
+                        fibonacci_direction(iang-1, nang, rot, theta, phi);
                     }
-                    theta = M_PI/2.0;
-                    if ((int)ndim > 2) theta = acos(1.0 - 2.0*ran2(&seed)); // theta = [0,pi] sample the whole sphere
 
                     if (verbose > 1) TurbGen_printf("theta = %f, phi = %f\n", theta, phi);
 
-                    rand = ik[0] + ran2(&seed) - 0.5;
+                    if (angles_sampling == 0)
+                        rand = ik[0] + ran2(&seed) - 0.5;
+                    else // stratified radii (additive recurrence, uncorrelated with the Fibonacci index)
+                        rand = ik[0] + fmod(rand_offset + (iang-1)*(sqrt(2.0)-1.0), 1.0) - 0.5;
                     k[X] = 2*M_PI * round(rand*sin(theta)*cos(phi)) / L[X];
                     if ((int)ndim > 1)
                         k[Y] = 2*M_PI * round(rand*sin(theta)*sin(phi)) / L[Y];
@@ -883,6 +1883,21 @@ class TurbGen
 
                 } // loop over angles
             } // loop over k
+
+            if (merge_modes) merge_duplicate_modes();
+
+            // report how well the sampled modes reproduce the power in each k-shell (see get_shell_power_error)
+            compute_shell_power_error(ikmin[0], ikmax[0], kc, false, shell_power_error);
+            if (verbose > 1 || (verbose && angles_sampling > 0))
+                TurbGen_printf("Relative error of the power in the k-shells: rms = %e, max = %e\n",
+                               shell_power_error[0], shell_power_error[1]);
+            // for stratified sampling, correct the remaining error from rounding to the k-space lattice
+            if (angles_sampling > 0) {
+                double residual[2];
+                compute_shell_power_error(ikmin[0], ikmax[0], kc, true, residual);
+                if (verbose) TurbGen_printf("Relative error of the power in the k-shells after renormalisation: rms = %e, max = %e\n",
+                                            residual[0], residual[1]);
+            }
         } // spect_form == 2
 
         if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"exiting.\n");
@@ -890,17 +1905,207 @@ class TurbGen
 
     }; // init_modes
 
+    // ******************************************************
+    private: void merge_duplicate_modes(void) {
+        // ******************************************************
+        // merge modes with the same lattice vector k or -k into one mode with amplitude sqrt(sum ampl^2)
+        // (see set_merge_duplicate_modes); keeps the order of the first occurrence of each mode
+        // ******************************************************
+        std::map<std::vector<long>, int> unique; // lattice vector -> index of merged mode
+        std::vector<double> mode_merged[3], ampl2_merged;
+        for (int m = 0; m < nmodes; m++) {
+            std::vector<long> ik(3, 0);
+            for (int d = 0; d < (int)ndim; d++) ik[d] = lround(mode[d][m] * L[d] / (2*M_PI));
+            // use the same representative for k and -k (first non-zero component positive)
+            for (int d = 0; d < 3; d++) {
+                if (ik[d] == 0) continue;
+                if (ik[d] < 0) for (int dd = 0; dd < 3; dd++) ik[dd] = -ik[dd];
+                break;
+            }
+            std::map<std::vector<long>, int>::iterator it = unique.find(ik);
+            if (it == unique.end()) {
+                unique[ik] = ampl2_merged.size();
+                for (int d = 0; d < (int)ndim; d++) mode_merged[d].push_back(mode[d][m]);
+                ampl2_merged.push_back(ampl[m]*ampl[m]);
+            } else {
+                ampl2_merged[it->second] += ampl[m]*ampl[m];
+            }
+        }
+        const int nmodes_sampled = nmodes;
+        nmodes = ampl2_merged.size();
+        for (int d = 0; d < (int)ndim; d++) mode[d] = mode_merged[d];
+        ampl.resize(nmodes);
+        for (int m = 0; m < nmodes; m++) ampl[m] = sqrt(ampl2_merged[m]);
+        if (verbose) TurbGen_printf("Merged %i sampled modes into %i unique modes (%.1f%% fewer modes).\n",
+                                    nmodes_sampled, nmodes, 100.0*(nmodes_sampled-nmodes)/std::max(nmodes_sampled,1));
+    }; // merge_duplicate_modes
+
+    // ******************************************************
+    private: double get_angles_budget_factor(const int ikmin, const int ikmax) {
+        // ******************************************************
+        // return the factor (<= 1) for the number of angles per k-shell, nang = 2^ndim * ceil(factor * ik^angles_exp),
+        // such that the total number of sampled angles (an upper bound of the number of modes) fits the mode budget
+        // ******************************************************
+        int max_nmodes = budget_nmodes;
+        if (budget_time > 0.0) {
+            const double ncells = (double)budget_grid[X] * budget_grid[Y] * budget_grid[Z];
+            max_nmodes = (int)std::min(budget_time / (get_evaluation_cost() * ncells), 1e9);
+            if (verbose) TurbGen_printf("Mode budget for evaluation time %e s on %i x %i x %i grid: %i modes\n",
+                                        budget_time, budget_grid[X], budget_grid[Y], budget_grid[Z], max_nmodes);
+        }
+        if ((budget_nmodes <= 0) && (budget_time <= 0.0)) return 1.0; // no budget
+        // total number of angles for a given factor
+        struct Count {
+            int ndim, ikmin, ikmax; double angles_exp;
+            long operator()(const double factor) const {
+                long n = 0;
+                for (int ik = ikmin; ik <= ikmax; ik++) n += pow(2.0,ndim) * ceil(factor*pow((double)ik,angles_exp));
+                return n;
+            }
+        } count = {(int)ndim, ikmin, ikmax, angles_exp};
+        if (count(1.0) <= max_nmodes) return 1.0; // fits without reduction
+        if (count(DBL_MIN) > max_nmodes) { // minimum: 2^ndim angles per shell
+            if (verbose) TurbGen_printf("WARNING: mode budget of %i modes is below the minimum of %li angles; using the minimum.\n",
+                                        max_nmodes, (ikmax-ikmin+1)*(long)pow(2.0,(int)ndim));
+            return DBL_MIN;
+        }
+        // bisection for the largest factor that fits the budget
+        double lo = 0.0, hi = 1.0;
+        for (int iter = 0; iter < 60; iter++) {
+            const double mid = 0.5*(lo+hi);
+            if (count(mid) <= max_nmodes) lo = mid; else hi = mid;
+        }
+        if (verbose) TurbGen_printf("Reducing the number of angles by a factor of %e to fit the budget of %i modes (%li angles).\n",
+                                    lo, max_nmodes, count(lo));
+        return std::max(lo, DBL_MIN);
+    }; // get_angles_budget_factor
+
+    // ******************************************************
+    private: static double get_evaluation_cost(void) {
+        // ******************************************************
+        // measure (once) the single-thread time per mode and per cell of get_turb_vector_unigrid on this machine,
+        // with a small band spectrum evaluated on a 32^3 grid (best of 3)
+        // ******************************************************
+        static double cost = 0.0;
+        if (cost > 0.0) return cost;
+        TurbGen tg;
+        tg.set_verbose(0);
+        const double L[3] = {1.0, 1.0, 1.0}, pos_beg[3] = {0.0, 0.0, 0.0}, pos_end[3] = {1.0, 1.0, 1.0};
+        const int n[3] = {32, 32, 32};
+        tg.init_single_realisation(3, L, 1.0, 3.0, 0, 0.0, 0.0, 0.5, 1);
+        std::vector<float> grid(3*n[X]*n[Y]*n[Z]);
+        float * return_grid[3] = {&grid[0], &grid[n[X]*n[Y]*n[Z]], &grid[2*n[X]*n[Y]*n[Z]]};
+        double best = DBL_MAX;
+        for (int rep = 0; rep < 3; rep++) {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            tg.get_turb_vector_unigrid(pos_beg, pos_end, n, return_grid);
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count());
+        }
+        cost = std::max(best, 1e-9) / ((double)tg.nmodes * n[X]*n[Y]*n[Z]);
+        return cost;
+    }; // get_evaluation_cost
+
+    // ******************************************************
+    private: void random_rotation(double rot[3][3]) {
+        // ******************************************************
+        // draw a uniformly distributed random rotation (3D: from a random unit quaternion; 2D: about the z axis)
+        // ******************************************************
+        for (int i = 0; i < 3; i++) for (int j = 0; j < 3; j++) rot[i][j] = (i == j) ? 1.0 : 0.0;
+        if ((int)ndim == 2) {
+            const double alpha = 2*M_PI * ran2(&seed);
+            rot[X][X] = cos(alpha); rot[X][Y] = -sin(alpha);
+            rot[Y][X] = sin(alpha); rot[Y][Y] =  cos(alpha);
+        }
+        if ((int)ndim == 3) {
+            const double u1 = ran2(&seed), u2 = 2*M_PI * ran2(&seed), u3 = 2*M_PI * ran2(&seed);
+            const double w = sqrt(1.0-u1)*sin(u2), x = sqrt(1.0-u1)*cos(u2), y = sqrt(u1)*sin(u3), z = sqrt(u1)*cos(u3);
+            rot[X][X] = 1-2*(y*y+z*z); rot[X][Y] =   2*(x*y-z*w); rot[X][Z] =   2*(x*z+y*w);
+            rot[Y][X] =   2*(x*y+z*w); rot[Y][Y] = 1-2*(x*x+z*z); rot[Y][Z] =   2*(y*z-x*w);
+            rot[Z][X] =   2*(x*z-y*w); rot[Z][Y] =   2*(y*z+x*w); rot[Z][Z] = 1-2*(x*x+y*y);
+        }
+    }; // random_rotation
+
+    // ******************************************************
+    private: void fibonacci_direction(const int i, const int n, const double rot[3][3], double & theta, double & phi) {
+        // ******************************************************
+        // return the angles of direction i of n evenly distributed directions (Fibonacci sphere in 3D,
+        // equally spaced in 2D, alternating left/right in 1D), after rotation with rot
+        // ******************************************************
+        if ((int)ndim == 1) {
+            theta = M_PI/2.0; phi = (i % 2 == 0) ? 0.0 : M_PI;
+            return;
+        }
+        double e[3], r[3];
+        if ((int)ndim == 2) {
+            const double a = 2*M_PI * (i+0.5) / n;
+            e[X] = cos(a); e[Y] = sin(a); e[Z] = 0.0;
+        } else {
+            const double golden_angle = M_PI * (3.0 - sqrt(5.0));
+            const double z = 1.0 - (2.0*i+1.0) / n, rxy = sqrt(std::max(0.0, 1.0-z*z));
+            e[X] = rxy*cos(golden_angle*i); e[Y] = rxy*sin(golden_angle*i); e[Z] = z;
+        }
+        for (int d = 0; d < 3; d++) r[d] = rot[d][X]*e[X] + rot[d][Y]*e[Y] + rot[d][Z]*e[Z];
+        theta = acos(std::max(-1.0, std::min(1.0, r[Z])));
+        phi = atan2(r[Y], r[X]);
+    }; // fibonacci_direction
+
+    // ******************************************************
+    private: void compute_shell_power_error(const int ikmin, const int ikmax, const double kc, const bool renormalise, double error[2]) {
+        // ******************************************************
+        // compare the power sum(ampl^2) of the generated modes in each k-shell (|k| L[X]/2pi rounded to the nearest
+        // integer) with the target power of the shell (that of all nang samples placed at |k| = ik), and return the
+        // rms and max relative error in error[]; the first and last shell are only partially inside [kmin, kmax] and
+        // are excluded. If renormalise, the amplitudes are then rescaled such that each (non-empty) shell has exactly
+        // the target power, and error[] is that after the renormalisation.
+        // ******************************************************
+        std::vector<int> shell(nmodes);
+        std::vector<double> power(ikmax+2, 0.0), target(ikmax+2, 0.0);
+        for (int m = 0; m < nmodes; m++) {
+            double ka2 = 0.0;
+            for (int d = 0; d < (int)ndim; d++) ka2 += mode[d][m]*mode[d][m];
+            shell[m] = std::min((int)round(sqrt(ka2)*L[X]/(2*M_PI)), ikmax+1);
+            power[shell[m]] += ampl[m]*ampl[m];
+        }
+        double err2 = 0.0, target2 = 0.0, err_max = 0.0;
+        for (int ik = ikmin+1; ik < ikmax; ik++) {
+            const double ka = 2*M_PI * ik / L[X];
+            if ((ka < kmin) || (ka > kmax)) continue;
+            double amplitude = pow(ka/kc,power_law_exp);
+            if (ka >= kmid) amplitude = pow(kmid/kmin,power_law_exp) * pow(ka/kmid,power_law_exp_2);
+            // nang * ampl^2 of the samples at |k| = ik (see init_modes)
+            target[ik] = amplitude * pow((double)ik,(int)ndim-1) * 4.0*sqrt(3.0) * pow(kc/ka,(int)ndim-1);
+            err2 += (power[ik]-target[ik])*(power[ik]-target[ik]);
+            target2 += target[ik]*target[ik];
+            err_max = std::max(err_max, fabs(power[ik]-target[ik])/target[ik]);
+        }
+        error[0] = (target2 > 0.0) ? sqrt(err2/target2) : 0.0;
+        error[1] = err_max;
+        if (renormalise) {
+            for (int m = 0; m < nmodes; m++)
+                if ((target[shell[m]] > 0.0) && (power[shell[m]] > 0.0)) ampl[m] *= sqrt(target[shell[m]]/power[shell[m]]);
+            compute_shell_power_error(ikmin, ikmax, kc, false, error);
+        }
+    }; // compute_shell_power_error
+
 
     // ******************************************************
     private: void OU_noise_init(void) {
         // ******************************************************
         // initialize pseudo random sequence for the Ornstein-Uhlenbeck (OU) process
         // ******************************************************
+        OU_noise_init(OUphases, seed);
+    }; // OU_noise_init
+
+    // ******************************************************
+    private: void OU_noise_init(std::vector<double> & OUphases, int & seed) const {
+        // ******************************************************
+        // initialise 'OUphases', drawing from random 'seed' (overloaded, e.g., for the phases of other seeds)
+        // ******************************************************
         OUphases.resize(nmodes*ncmp*2);
         for (int m = 0; m < nmodes; m++) {
             for (int d = 0; d < ncmp; d++) {
                 for (int ir = 0; ir < 2; ir++) {
-                    OUphases[2*ncmp*m+2*d+ir] = OUvar * get_random_number();
+                    OUphases[2*ncmp*m+2*d+ir] = OUvar * get_random_number(&seed);
                 }
             }
         }
@@ -937,12 +2142,21 @@ class TurbGen
         //   Federrath et al. (2010, A&A 512, A81); Eq. (4)
         //
         // ******************************************************
+        OU_noise_update(OUphases, seed);
+    }; // OU_noise_update
+
+    // ******************************************************
+    private: void OU_noise_update(std::vector<double> & OUphases, int & seed) const {
+        // ******************************************************
+        // update Ornstein-Uhlenbeck sequence in 'OUphases', drawing from random 'seed'
+        // (overloaded, so the next OU step can be computed outside the internal state)
+        // ******************************************************
         const double damping_factor = exp(-dt/t_decay);
         for (int m = 0; m < nmodes; m++) {
             for (int d = 0; d < ncmp; d++) {
                 for (int ir = 0; ir < 2; ir++) {
                     OUphases[2*ncmp*m+2*d+ir] = OUphases[2*ncmp*m+2*d+ir] * damping_factor +
-                        sqrt(1.0 - damping_factor*damping_factor) * OUvar * get_random_number();
+                        sqrt(1.0 - damping_factor*damping_factor) * OUvar * get_random_number(&seed);
                 }
             }
         }
@@ -955,6 +2169,18 @@ class TurbGen
         // This routine applies the projection operator based on the OU phases.
         // See Eq. (6) in Federrath et al. (2010).
         // ******************************************************
+        std::shared_ptr<Snapshot> snap = std::make_shared<Snapshot>();
+        get_decomposition_coeffs(OUphases, snap->aka, snap->akb);
+        publish_snapshot(snap);
+    }; // get_decomposition_coeffs
+
+    // ******************************************************
+    private: void get_decomposition_coeffs(const std::vector<double> & OUphases,
+                                           std::vector<double> aka[], std::vector<double> akb[]) const {
+        // ******************************************************
+        // apply the projection operator to 'OUphases' and return into 'aka' and 'akb'
+        // (overloaded, so the coefficients of the next OU step can be computed outside the internal state)
+        // ******************************************************
         if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"entering.\n");
         // resize aka and akb
         for (int d = 0; d < 3; d++) {
@@ -995,10 +2221,292 @@ class TurbGen
                 }
             }
         }
+        // bring the coefficients into the order of the mode table (if sorted; see set_mode_truncation)
+        if (table && !table->order.empty()) {
+            for (int d = 0; d < 3; d++) {
+                const std::vector<double> aka_orig = aka[d], akb_orig = akb[d];
+                for (int m = 0; m < nmodes; m++) {
+                    aka[d][m] = aka_orig[table->order[m]];
+                    akb[d][m] = akb_orig[table->order[m]];
+                }
+            }
+        }
         if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"exiting.\n");
     }; // get_decomposition_coeffs
 
 
+    // ******************************************************
+    private: void init_modes_collective(void) {
+        // ******************************************************
+        // generate the modes with init_modes, or, with an MPI communicator (see set_mpi_comm),
+        // on rank 0 of the communicator only and broadcast them to the other ranks
+        // ******************************************************
+#ifdef TURBGEN_HAVE_MPI
+        int rank = 0, size = 1;
+        if (mpi_comm != MPI_COMM_NULL) { MPI_Comm_rank(mpi_comm, &rank); MPI_Comm_size(mpi_comm, &size); }
+        if (size > 1) {
+            if (rank == 0) init_modes();
+            // scalars: number of modes, random seed after sampling the modes (used for the OU phases), shell power error
+            double scalars[4] = {(double)nmodes, (double)seed, shell_power_error[0], shell_power_error[1]};
+            MPI_Bcast(scalars, 4, MPI_DOUBLE, 0, mpi_comm);
+            nmodes = (int)scalars[0]; seed = (int)scalars[1];
+            shell_power_error[0] = scalars[2]; shell_power_error[1] = scalars[3];
+            for (int d = 0; d < (int)ndim; d++) {
+                mode[d].resize(nmodes);
+                if (nmodes > 0) MPI_Bcast(&mode[d][0], nmodes, MPI_DOUBLE, 0, mpi_comm);
+            }
+            ampl.resize(nmodes);
+            if (nmodes > 0) MPI_Bcast(&ampl[0], nmodes, MPI_DOUBLE, 0, mpi_comm);
+            if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"%i modes broadcast to %i ranks.\n", nmodes, size);
+            return;
+        }
+#endif
+        init_modes();
+    }; // init_modes_collective
+
+#ifdef TURBGEN_HAVE_MPI
+    // ******************************************************
+    private: const double * init_node_shared_window(const std::vector<double> & data) {
+        // ******************************************************
+        // copy 'data' into a new MPI-3 node-shared memory window (allocated on the first rank of each node);
+        // returns the node-local address of the data, or NULL if not available (collective over mpi_comm)
+        // ******************************************************
+        mpi_shared_win.reset(); // free the previous window (collective)
+#if MPI_VERSION >= 3
+        MPI_Comm node_comm;
+        MPI_Comm_split_type(mpi_comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+        int node_rank = 0;
+        MPI_Comm_rank(node_comm, &node_rank);
+        const MPI_Aint nbytes = (node_rank == 0) ? (MPI_Aint)(data.size()*sizeof(double)) : 0;
+        double * base = NULL;
+        MPI_Win win;
+        MPI_Win_allocate_shared(nbytes, sizeof(double), MPI_INFO_NULL, node_comm, &base, &win);
+        MPI_Aint size; int disp_unit;
+        MPI_Win_shared_query(win, 0, &size, &disp_unit, &base);
+        MPI_Win_fence(0, win);
+        if ((node_rank == 0) && !data.empty()) memcpy(base, &data[0], data.size()*sizeof(double));
+        MPI_Win_fence(0, win);
+        MPI_Comm_free(&node_comm);
+        // the window is freed when the last copy of this object is re-initialised or destroyed (before MPI_Finalize)
+        mpi_shared_win = std::shared_ptr<MPI_Win>(new MPI_Win(win), [](MPI_Win * w) {
+            int finalized = 0; MPI_Finalized(&finalized);
+            if (!finalized) MPI_Win_free(w);
+            delete w;
+        });
+        if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"mode table (%li bytes) placed in node-shared window.\n",
+                                        (long)(data.size()*sizeof(double)));
+        return data.empty() ? NULL : base;
+#else
+        return NULL;
+#endif
+    }; // init_node_shared_window
+#endif
+
+    // ******************************************************
+    private: void init_mode_table(void) {
+        init_mode_table(false);
+    };
+    // ******************************************************
+    private: void init_mode_table(const bool collective) {
+        // ******************************************************
+        // copy modes and amplitudes (including normalisation factors) into the table shared by all snapshots;
+        // if collective (called by all ranks of mpi_comm), the table may be placed into a node-shared window
+        // ******************************************************
+        std::shared_ptr<ModeTable> tab = std::make_shared<ModeTable>();
+        tab->ndim = ndim;
+        tab->ncmp = ncmp;
+        tab->nmodes = nmodes;
+        tab->taper = 0.0;
+        // data layout: mode[X], mode[Y], mode[Z], ampl, kabs (only with mode truncation), each of size nmodes
+        const int narr = truncate_modes ? 5 : 4;
+        std::vector<double> data(narr*nmodes, 0.0);
+        std::vector<int> order(nmodes);
+        for (int m = 0; m < nmodes; m++) order[m] = m;
+        std::vector<double> kabs;
+        if (truncate_modes) { // sort by |k| (see set_mode_truncation)
+            kabs.resize(nmodes);
+            for (int m = 0; m < nmodes; m++) {
+                double k2 = 0.0;
+                for (int d = 0; d < (int)ndim; d++) k2 += mode[d][m]*mode[d][m];
+                kabs[m] = sqrt(k2);
+            }
+            std::stable_sort(order.begin(), order.end(), [&](const int a, const int b) { return kabs[a] < kabs[b]; });
+            tab->order = order;
+            tab->taper = truncation_taper;
+            if (verbose > 1) TurbGen_printf(FuncSig(__func__)+"modes sorted by |k| for resolution-aware truncation.\n");
+        }
+        for (int m = 0; m < nmodes; m++) {
+            const int mo = order[m];
+            for (int d = 0; d < (int)ndim; d++) data[d*nmodes+m] = mode[d][mo];
+            data[3*nmodes+m] = 2.0 * sol_weight_norm * ampl[mo];
+            if (truncate_modes) data[4*nmodes+m] = kabs[mo];
+        }
+        const double * base = NULL;
+#ifdef TURBGEN_HAVE_MPI
+        if (collective && mpi_node_shared && (mpi_comm != MPI_COMM_NULL)) base = init_node_shared_window(data);
+#else
+        (void)collective; // only used for the node-shared window
+#endif
+        if (!base) { tab->data.swap(data); base = tab->data.empty() ? NULL : &tab->data[0]; }
+        for (int d = 0; d < 3; d++) tab->mode[d] = base ? base + d*nmodes : NULL;
+        tab->ampl = base ? base + 3*nmodes : NULL;
+        tab->kabs = (base && truncate_modes) ? base + 4*nmodes : NULL;
+        table = tab;
+    }; // init_mode_table
+
+    // ******************************************************
+    private: void publish_snapshot(const std::shared_ptr<Snapshot> & snap) {
+        // ******************************************************
+        // complete 'snap' with the current step and amplitude factors, and make it the current pattern;
+        // readers holding the previous handle keep evaluating the previous pattern until they release it
+        // ******************************************************
+        snap->step = step;
+        snap->table = table;
+        for (int d = 0; d < 3; d++) snap->ampl_factor[d] = ampl_factor[d];
+        std::atomic_store(&snapshot, SnapshotHandle(snap));
+    }; // publish_snapshot
+
+    // ******************************************************
+    private: void async_launch(void) {
+        // ******************************************************
+        // start the background worker computing the OU step after the current one (see set_async_update)
+        // ******************************************************
+#ifdef HAVE_THREADS
+        if (!async.enabled || (dt <= 0.0)) return;
+        async_join();
+        async.step = step + 1;
+        async.seed = seed;
+        async.OUphases = OUphases;
+        async.snapshot = std::make_shared<Snapshot>();
+        async.snapshot->table = table;
+        // the grids requested during the current step will be precomputed for the next step
+        async.grids.swap(async.grids_requested);
+        async.grids_requested.clear();
+        async.pending = true;
+        async.worker = std::thread(&TurbGen::async_compute, this);
+#endif
+    }; // async_launch
+
+    // ******************************************************
+    private: void async_compute(void) {
+        // ******************************************************
+        // executed by the background worker; only touches the 'async' containers of the next OU step,
+        // and reads only data that remain constant until the next initialisation (modes, amplitudes, parameters),
+        // which first stops the worker (see async_reset)
+        // ******************************************************
+        OU_noise_update(async.OUphases, async.seed);
+        get_decomposition_coeffs(async.OUphases, async.snapshot->aka, async.snapshot->akb);
+        for (unsigned int ig = 0; ig < async.grids.size(); ig++) {
+            AsyncGrid & grid = async.grids[ig];
+            const long nt[3] = {grid.n[X]+2L*grid.nguard[X], grid.n[Y]+2L*grid.nguard[Y], grid.n[Z]+2L*grid.nguard[Z]};
+            float * grid_out[3] = {NULL, NULL, NULL};
+            for (int d = 0; d < ncmp; d++) { grid.field[d].resize(nt[X]*nt[Y]*nt[Z]); grid_out[d] = &grid.field[d][0]; }
+            const long stride[3] = {1, nt[X], nt[X]*nt[Y]};
+            const long off = grid.nguard[X]*stride[X] + grid.nguard[Y]*stride[Y] + grid.nguard[Z]*stride[Z];
+            const long offset[3] = {off, off, off};
+            compute_turb_vector_unigrid(*async.snapshot, grid.pos_beg, grid.pos_end, grid.n, grid.nguard, grid_out, stride, offset, false,
+                                        NULL, NULL, NULL, NULL, NULL);
+        }
+    }; // async_compute
+
+    // ******************************************************
+    private: void async_join(void) {
+        // ******************************************************
+        // wait for the background worker to finish
+        // ******************************************************
+#ifdef HAVE_THREADS
+        if (async.worker.joinable()) async.worker.join();
+#endif
+    }; // async_join
+
+    // ******************************************************
+    private: void async_reset(void) {
+        // ******************************************************
+        // wait for the background worker, and discard its pending step and all precomputed and requested grids
+        // ******************************************************
+        async_join();
+        async.pending = false;
+        async.step = -1;
+        async.grids.clear(); async.grids_current.clear(); async.grids_requested.clear();
+    }; // async_reset
+
+    // ******************************************************
+    private: bool async_handover(const int next_step) {
+        // ******************************************************
+        // take over OU phases, seed, and precomputed grids of 'next_step' from the background worker; the pattern
+        // stays in async.snapshot until published by check_for_update; returns false if 'next_step' is not available
+        // ******************************************************
+        if (!async.enabled || !async.pending) return false;
+        async_join();
+        async.pending = false;
+        if (async.step != next_step) return false;
+        OUphases.swap(async.OUphases);
+        seed = async.seed;
+        async.grids_current.swap(async.grids);
+        async.grids.clear();
+        if (verbose > 1) TurbGen_printf("handed over precomputed OU step %i\n", next_step);
+        return true;
+    }; // async_handover
+
+    // ******************************************************
+    private: int async_find_grid(const std::vector<AsyncGrid> & grids,
+                                 const double pos_beg[], const double pos_end[], const int n[], const int nguard[]) const {
+        // ******************************************************
+        // return index of grid with identical pos_beg, pos_end, n, nguard in 'grids' (or -1 if not found)
+        // ******************************************************
+        for (unsigned int ig = 0; ig < grids.size(); ig++) {
+            bool match = true;
+            for (int d = 0; d < 3; d++)
+                if ((grids[ig].pos_beg[d] != pos_beg[d]) || (grids[ig].pos_end[d] != pos_end[d]) || (grids[ig].n[d] != n[d]) ||
+                    (grids[ig].nguard[d] != nguard[d])) match = false;
+            if (match) return ig;
+        }
+        return -1;
+    }; // async_find_grid
+
+    // ******************************************************
+    private: int async_request_grid(const double pos_beg[], const double pos_end[], const int n[], const int nguard[]) {
+        // ******************************************************
+        // remember the grid for the background worker to precompute for the next steps (see set_async_update);
+        // return the index of its precomputed field for the current step in async.grids_current (or -1 if not available)
+        // ******************************************************
+        if (async_find_grid(async.grids_requested, pos_beg, pos_end, n, nguard) < 0) {
+            AsyncGrid grid;
+            for (int d = 0; d < 3; d++) {
+                grid.pos_beg[d] = pos_beg[d]; grid.pos_end[d] = pos_end[d]; grid.n[d] = n[d]; grid.nguard[d] = nguard[d];
+            }
+            async.grids_requested.push_back(grid);
+        }
+        return async_find_grid(async.grids_current, pos_beg, pos_end, n, nguard);
+    }; // async_request_grid
+
+    // ******************************************************
+    private: template <typename T> void async_copy_grid(const int ig, const Snapshot & snap, const int n[], const int ng[],
+                T * base[], const long stride[], const long offset[],
+                const double * weight, const long weight_stride[], double weighted_sum[],
+                double sum[], double sum_sq[]) const {
+        // ******************************************************
+        // return the precomputed field async.grids_current[ig] (times ampl_factor) like get_turb_vector_unigrid_strided;
+        // read-only, so several blocks can be copied concurrently (see get_turb_vector_multiblock)
+        // ******************************************************
+        const AsyncGrid & grid = async.grids_current[ig];
+        const bool have_sums = weight || sum || sum_sq;
+        double val[3] = {0.0, 0.0, 0.0};
+        const int nt[3] = {n[X]+2*ng[X], n[Y]+2*ng[Y], n[Z]+2*ng[Z]}; // including guard cells
+        for (int k = -ng[Z]; k < n[Z]+ng[Z]; k++) for (int j = -ng[Y]; j < n[Y]+ng[Y]; j++) for (int i = -ng[X]; i < n[X]+ng[X]; i++) {
+            const long index = (long)(k+ng[Z])*nt[X]*nt[Y] + (long)(j+ng[Y])*nt[X] + (i+ng[X]);
+            const long out_index = i*stride[X] + j*stride[Y] + k*stride[Z];
+            for (int d = 0; d < ncmp; d++) {
+                T out = grid.field[d][index] * snap.ampl_factor[d];
+                base[d][offset[d] + out_index] = out;
+                val[d] = out;
+            }
+            if (have_sums && (i >= 0) && (i < n[X]) && (j >= 0) && (j < n[Y]) && (k >= 0) && (k < n[Z]))
+                add_to_unigrid_sums(ncmp, val, i, j, k, weight, weight_stride, weighted_sum, sum, sum_sq);
+        }
+    }; // async_copy_grid
+
+
     // ******************************************************
     private: double get_random_number(void) {
         // ******************************************************
@@ -1007,15 +2515,21 @@ class TurbGen
         //  using the Box-Muller transformation in polar coordinates. The
         //  resulting Gaussian has unit variance.
         // ******************************************************
-        double r1 = ran1s(&seed);
-        double r2 = ran1s(&seed);
+        return get_random_number(&seed);
+    }; // get_random_number
+
+    // ******************************************************
+    private: double get_random_number(int * seed) const {
+        // ******************************************************
+        double r1 = ran1s(seed);
+        double r2 = ran1s(seed);
         double g1 = sqrt(2.0*log(1.0/r1))*cos(2*M_PI*r2);
         return g1;
     }; // get_random_number
 
 
     // ************** Numerical recipes ran1s ***************
-    private: double ran1s(int * idum) {
+    private: double ran1s(int * idum) const {
         // ******************************************************
         static const int IA=16807, IM=2147483647, IQ=127773, IR=2836;
         static const double AM=1.0/IM, RNMX=1.0-1.2e-7;
@@ -1073,7 +2587,7 @@ class TurbGen
 
 
     // ******************************************************
-    private: void TurbGen_printf(std::string format, ...) {
+    private: void TurbGen_printf(std::string format, ...) const {
         // ******************************************************
         // special printf prepends string and only lets PE=0 print
         // ******************************************************
@@ -1085,7 +2599,7 @@ class TurbGen
     }; // TurbGen_printf
 
     // ******************************************************
-    private: void TurbGen_printf_raw(std::string format, ...) {
+    private: void TurbGen_printf_raw(std::string format, ...) const {
         // ******************************************************
         // special printf prepends string and only lets PE=0 print
         // ******************************************************
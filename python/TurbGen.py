@@ -2,7 +2,9 @@
 # -*- coding: utf-8 -*-
 # written by Christoph Federrath, 2022
 
+import os
 import sys
+import json
 import argparse
 import numpy as np
 import cfpack as cfp
@@ -22,6 +24,28 @@ def get_number_of_components(ndim):
     return ncmp
 # =========================================================
 
+# === read dataset from HDF5 file or from raw output (JSON sidecar written by TurbGen -raw) ===
+def read(inputfile, dsetname):
+    if not inputfile.endswith(".json"):
+        # parameters (e.g., 'ndim', 'kmin') are in the 'integer scalars' and 'real scalars' tables of (name, value);
+        # older files have them as separate datasets
+        import h5py
+        with h5py.File(inputfile, 'r') as f:
+            if dsetname not in f:
+                for table in ["integer scalars", "real scalars"]:
+                    if table not in f: continue
+                    for name, value in f[table][()]:
+                        if name.decode().strip() == dsetname: return value
+        return hdfio.read(inputfile, dsetname)
+    with open(inputfile) as f: meta = json.load(f)
+    path = os.path.dirname(inputfile)
+    if dsetname in meta["files"]: # turb_field_*: memory-mapped little-endian float32 file
+        return np.memmap(os.path.join(path, meta["files"][dsetname]), dtype=meta["dtype"], mode='r', shape=tuple(meta["shape"]))
+    if dsetname in ["Fourier_modes", "Fourier_amplitudes"]:
+        return np.fromfile(os.path.join(path, meta[dsetname]["file"]), dtype=meta[dsetname]["dtype"]).reshape(meta[dsetname]["shape"])
+    return np.array(meta[dsetname])
+# =========================================================
+
 # === generate turbulent field by calling C++ TurbGen ===
 def generate(args, parser):
     # error checking on arguments
@@ -62,17 +86,17 @@ def generate(args, parser):
     cfp.run_shell_command(cmd) # run TurbGen
 # =========================================================
 
-# === analyse turbulent field in HDF5 file ===
+# === analyse turbulent field in HDF5 file (or raw output via its JSON sidecar) ===
 def analyse(args, parser):
     # read file and analyse
-    ndim = float(hdfio.read(args.inputfile, 'ndim'))
-    ncmp = int(hdfio.read(args.inputfile, 'ncmp'))
+    ndim = float(read(args.inputfile, 'ndim'))
+    ncmp = int(read(args.inputfile, 'ncmp'))
     # read components
     dirs = ['x', 'y', 'z']
     dsetnamebase = 'turb_field_'
     dat = []
     for ic in range(ncmp): # loop over components
-        dat.append(hdfio.read(args.inputfile, dsetnamebase+dirs[ic]))
+        dat.append(read(args.inputfile, dsetnamebase+dirs[ic]))
     dat = np.array(dat)
     # statistics
     mean = np.array([dat[d].mean() for d in range(ncmp)])
@@ -107,13 +131,13 @@ def analyse(args, parser):
     cfp.plot(x=k[ind], y=sp["P_tot"][ind], label="total")
     if "P_lgt" in sp: cfp.plot(x=k[ind], y=sp["P_lgt"][ind], label="long")
     if "P_trv" in sp: cfp.plot(x=k[ind], y=sp["P_trv"][ind], label="trans")
-    spect_form = int(hdfio.read(args.inputfile, 'spect_form'))
+    spect_form = int(read(args.inputfile, 'spect_form'))
     if spect_form == 2: # power law
-        power_law_exp   = float(hdfio.read(args.inputfile, 'power_law_exp'))
-        power_law_exp_2 = float(hdfio.read(args.inputfile, 'power_law_exp_2'))
-        kmin = float(hdfio.read(args.inputfile, 'kmin'))
-        kmid = float(hdfio.read(args.inputfile, 'kmid'))
-        kmax = float(hdfio.read(args.inputfile, 'kmax'))
+        power_law_exp   = float(read(args.inputfile, 'power_law_exp'))
+        power_law_exp_2 = float(read(args.inputfile, 'power_law_exp_2'))
+        kmin = float(read(args.inputfile, 'kmin'))
+        kmid = float(read(args.inputfile, 'kmid'))
+        kmax = float(read(args.inputfile, 'kmax'))
         x = cfp.get_1d_coords(cmin=kmin, cmax=kmax, ndim=2000, cell_centred=False)
         y = sp["P_tot"][ind][0] * x**power_law_exp
         ind = x >= kmid